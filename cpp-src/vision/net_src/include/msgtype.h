@@ -21,6 +21,7 @@ enum class message_type : unsigned char {
 	DISCOVER = 5,			//!< Type for UDP discovery packets (bidirectional)
 	VIDEO_STREAM = 6,		//!< Type for raw OpenCV matrix video data streams
 	START_VIDEO_STREAM = 7,		//!< Type for advertising WPILib video streams.
+	FREE_SPACE = 8,			//!< Type for free space scans (Jetson to Rio only, broadcast every camera frame)
 };
 
 /*! \class message_payload
@@ -161,3 +162,36 @@ struct goal_distance_msg : public message_payload {
 	void frombuffer(nbstream& stream);
 };
 
+/*! \class free_space_msg
+ *  \brief Distance to the nearest obstacle at evenly spaced bearings in front of the robot.
+ *
+ * Bin i covers bearings [startAngle + i*angleStep, startAngle + (i+1)*angleStep), in radians, positive to the right.
+ * Size: 10 bytes + 2 bytes per bin (138 bytes for 64 bins).
+ */
+struct free_space_msg : public message_payload {
+	/*
+	 * Raw format (all fields big-endian):
+	 * - 0 / startAngle: Bearing of the left edge of bin 0, signed microradians = 4 bytes
+	 * - 4 / angleStep: Width of each bin, signed microradians = 4 bytes
+	 * - 8 / nBins: Number of bins = 2 bytes
+	 * - 10 / range: Distance for each bin, unsigned inches = 2 bytes each
+	 * - 10+(2*nBins) : last byte of data
+	 */
+
+	static const uint16_t noObstacle = 0xFFFF;	//!< range value for bins with no obstacle in view.
+	static const size_t headerSize = 10;		//!< Bytes before the first range value.
+
+	double startAngle;		//!< Bearing of the left edge of the first bin.
+	double angleStep;		//!< Width of each bin.
+	std::vector<uint16_t> range;	//!< Distance to the nearest obstacle in each bin, in inches, or noObstacle.
+
+	/*! \fn free_space_msg()
+	 *  \brief Creates an empty scan.
+	 */
+	free_space_msg() : startAngle(0), angleStep(0) {};
+	free_space_msg(double start, double step, const std::vector<float>& distances);
+
+	message_type typeof_data() { return message_type::FREE_SPACE; };
+	void tobuffer(nbstream& stream);
+	void frombuffer(nbstream& stream);
+};
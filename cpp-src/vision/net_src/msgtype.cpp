@@ -1,6 +1,8 @@
 #include "msgtype.h"
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 /* ----------------------------------------------------------------- */
 /*			class message				     */
@@ -77,6 +79,12 @@ std::unique_ptr<message_payload> message::unwrap_packet() {
 			out->frombuffer(stream);
 			break;
 		}			
+		case message_type::FREE_SPACE:
+		{
+			out.reset(new free_space_msg);
+			out->frombuffer(stream);
+			break;
+		}
 		case message_type::DISCOVER:
 		{
 			//std::cout << "Received DISCOVER packet." << std::endl;
@@ -131,3 +139,57 @@ void goal_distance_msg::frombuffer(nbstream& stream) {
 	horizAngleMid = stream.getDouble();
 	distanceBottom = stream.getDouble();
 }
+
+/* ----------------------------------------------------------------- */
+/*			class free_space_msg				*/
+/* ----------------------------------------------------------------- */
+
+/*! \fn free_space_msg(double start, double step, const std::vector<float>& distances)
+ *  \brief Constructs a free space message from a scan.
+ *
+ *  \param start Bearing of the left edge of the first bin.
+ *  \param step Width of each bin.
+ *  \param distances Distance to the nearest obstacle in each bin, in inches; distances that are infinite or
+ *  too far to encode are sent as noObstacle.
+ */
+free_space_msg::free_space_msg(double start, double step, const std::vector<float>& distances) :
+	startAngle(start), angleStep(step), range(distances.size()) {
+	for(size_t i=0;i<distances.size();i++) {
+		float d = std::max(0.0f, distances[i]);
+		range[i] = (d < noObstacle) ? static_cast<uint16_t>(d + 0.5f) : noObstacle;
+	}
+}
+
+/* Angles are sent as fixed-width microradians: putDouble() writes a variable-length string. */
+static int32_t toMicroradians(double a) {
+	return static_cast<int32_t>(std::lround(a * 1e6));
+}
+
+void free_space_msg::tobuffer(nbstream& stream) {
+	stream.put32(static_cast<uint32_t>(toMicroradians(startAngle)));
+	stream.put32(static_cast<uint32_t>(toMicroradians(angleStep)));
+
+	stream.put16(static_cast<uint16_t>(range.size()));
+	for(uint16_t r : range) {
+		stream.put16(r);
+	}
+}
+
+/* The bin count is capped at what the payload actually holds, so a truncated packet is never read past. */
+void free_space_msg::frombuffer(nbstream& stream) {
+	if(stream.getbufsz() < headerSize) {
+		startAngle = 0;
+		angleStep = 0;
+		range.clear();
+		return;
+	}
+
+	startAngle = static_cast<int32_t>(stream.get32()) * 1e-6;
+	angleStep = static_cast<int32_t>(stream.get32()) * 1e-6;
+
+	size_t n = std::min<size_t>(stream.get16(), (stream.getbufsz() - headerSize) / 2);
+	range.resize(n);
+	for(uint16_t& r : range) {
+		r = stream.get16();
+	}
+}
@@ -4,12 +4,23 @@
 #include "msgtype.h"
 #include "wpilib_cameraserver.h"
 #include "visproc_interface.h"
+#include "visproc_context.h"
+#include "visproc_profiler.h"
+#include "score_cascade.h"
+#include "target_tracker.h"
+#include "camera_model.h"
+#include "obsdetect.h"
 #include "opencv2/videoio.hpp"
 #include "opencv2/imgproc.hpp"
 #include <iostream>
 #include <thread>
 #include <mutex>
 #include <unordered_map>
+#include <atomic>
+#include <sstream>
+#include <csignal>
+#include <cstdlib>
+#include <algorithm>
 
 const int serverPort = 5800;
 const int visionPort = 5801;
@@ -17,6 +28,19 @@ std::mutex cout_mutex;
 
 const int visionRecvFPS = 15;
 
+std::string goalPipelineFile; // set with --pipeline; empty = built-in preprocessing
+bool skipStaticFrames = false; // set with --skip-static
+bool trackGoals = false; // set with --track: report the tracker's filtered values instead of raw detections
+unsigned int detectEvery = 1; // set with --detect-every (implies --track): run the detector on every Nth frame
+bool verbose = false; // set with --verbose: print the pipeline's per-contour debugging output (disables parallel scoring)
+unsigned int freeSpaceBins = 0; // set with --free-space: broadcast a free space scan with this many bins every frame; 0 = off
+
+std::atomic<bool> profileDumpRequested(false); // set by SIGUSR1
+
+void profileDumpHandler(int sig) {
+	profileDumpRequested = true;
+}
+
 struct threadholder {
 	std::thread discover;
 	std::thread periodic;
@@ -76,6 +100,16 @@ void periodic() {
 		discPacket.addr = bcast;
 
 		broadSock.send(discPacket);
+
+		if(profileDumpRequested.exchange(false)) {
+			std::ostringstream report;
+			report << "Stage latencies:" << std::endl;
+			visproc_profileReport(report);
+			report << "Goal scoring tests:" << std::endl;
+			goal_cascade.report(report);
+			lockedPrint(report.str());
+		}
+
 		std::this_thread::sleep_for(std::chrono::milliseconds(5));	
 	}
 }
@@ -90,6 +124,15 @@ double currentAngle = -1;
 void vision_thread() {
 	registerThread("vision");
 
+	vision_pipeline pipeline;
+	if(!goalPipelineFile.empty()) {
+		if(pipeline.load(goalPipelineFile)) {
+			lockedPrint(std::string("Using preprocessing pipeline ") + pipeline.getName());
+		} else {
+			lockedPrint("Could not load pipeline, using built-in preprocessing.");
+		}
+	}
+
 	serverSocket listenSock(visionPort, SOCK_STREAM);
 	
 	lockedPrint("Listening for connections.");
@@ -106,31 +149,92 @@ void vision_thread() {
 
 		lockedPrint("Vision thread running.");
 
+		target_tracker tracker;
+		std::vector<tracker_measurement> measurements;
+		unsigned int frameNumber = 0;
+
+		visproc_context ctx;
+		ctx.roiTracking = true;
+		if(trackGoals) {
+			ctx.tracker = &tracker;
+		}
+		ctx.parallelStrips = cv::getNumThreads();
+		ctx.skipStaticFrames = skipStaticFrames;
+		if(!pipeline.empty()) {
+			ctx.preprocess = &pipeline;
+		}
+
+		obstacle_context obsCtx;
+		free_space_scan freeSpace;
+
+		netaddr bcast = getbroadcast();
+		bcast.setPort(serverPort);
+		serverSocket broadSock;
+		broadSock.setBroadcast();
+
+		bool wasDegraded = false;
 		while(true) {
 			cv::Mat src = getImageFromServer(vSock);
-	
-			scoredContour out = goal_pipeline(goal_preprocess_pipeline(src));
+			cv::Size frameSz = src.size();
+
+			bool found = false;
+			double score = 0;
 			double dist = -1;
 			double angle = -1;
-			if( out.second.size() > 0 ) {
-				cv::Rect bounds = cv::boundingRect(out.second);
-				cv::Size frameSz = src.size();
-				dist = getDistance(bounds.height, goalSz.height, frameSz.height, fovVert);
-				angle = getAngleOffCenter(bounds.x + (bounds.width/2), frameSz.width, fovHoriz);
+
+			// with --detect-every, frames in between just report the tracker's prediction
+			bool detect = !trackGoals || ((frameNumber++ % detectEvery) == 0) || (tracker.best() == NULL);
+			if(detect) {
+				goal_pipeline(goal_preprocess_pipeline(src, ctx, !verbose), ctx, !verbose);
+
+				// glare etc.: contour extraction hit its caps, so the result may be coarse or missing
+				if(ctx.frameDegraded != wasDegraded) {
+					wasDegraded = ctx.frameDegraded;
+					lockedPrint(wasDegraded ? "Contour limits exceeded, processing degraded frames." : "Contour limits no longer exceeded.");
+				}
+
+				measurements.clear();
+				if( ctx.detections.size() > 0 ) {
+					const contour_record& best = ctx.detections[0];
+					const cv::Rect& bounds = best.bounds;
+					found = true;
+					score = best.score;
+					dist = getDistance(bounds, goalSz.height, frameSz);
+					angle = getAngleOffCenter(bounds, frameSz);
+
+					tracker_measurement m = { bounds, score, dist, angle };
+					measurements.push_back(m);
+				}
+
+				if(trackGoals) {
+					tracker.update(measurements, ctx.resultTicks);
+				}
+			}
+
+			if(trackGoals) {
+				cv::Rect predicted;
+				found = tracker.predict(cv::getTickCount(), predicted, dist, angle, score);
+				if(!found) {
+					score = 0;
+					dist = -1;
+					angle = -1;
+				}
+			}
+
+			if(freeSpaceBins > 0) {
+				obs_freeSpace(obs_getObsMask(src, obsCtx), freeSpaceBins, freeSpace);
+
+				free_space_msg fsMsg(freeSpace.startAngle, freeSpace.angleStep, freeSpace.range);
+				netmsg fsPacket = message::wrap_packet(&fsMsg);
+				fsPacket.addr = bcast;
+				broadSock.send(fsPacket);
 			}
 
 			{
 				std::lock_guard<std::mutex> lock(visionDataMutex);
 
-				if( out.second.size() > 0 ) {
-					currentStatus = true;
-					currentScore = out.first;
-				
-				} else {
-					currentStatus = false;
-					currentScore = 0;
-				}
-
+				currentStatus = found;
+				currentScore = score;
 				currentDistance = dist;
 				currentAngle = angle;
 			}
@@ -173,7 +277,44 @@ void listen_server() {
 	}
 }
 
-int main() {
+int main(int argc, char** argv) {
+	for(int i=1;i<argc;i++) {
+		if((std::string(argv[i]) == "--pipeline") && (i+1 < argc)) {
+			goalPipelineFile = argv[++i];
+		} else if(std::string(argv[i]) == "--skip-static") {
+			skipStaticFrames = true;
+		} else if((std::string(argv[i]) == "--camera") && (i+1 < argc)) {
+			if(!visproc_camera.load(argv[++i])) {
+				return 1;
+			}
+		} else if(std::string(argv[i]) == "--track") {
+			trackGoals = true;
+		} else if((std::string(argv[i]) == "--detect-every") && (i+1 < argc)) {
+			detectEvery = std::max(1, atoi(argv[++i]));
+			trackGoals = true;
+		} else if((std::string(argv[i]) == "--min-score") && (i+1 < argc)) {
+			goal_cascade.minScore = atof(argv[++i]);
+		} else if((std::string(argv[i]) == "--score-order") && (i+1 < argc)) {
+			if(!goal_cascade.setOrder(argv[++i])) {
+				std::cerr << "Invalid --score-order; expected each of " << goal_cascade.getOrder() << " once." << std::endl;
+				return 1;
+			}
+		} else if(std::string(argv[i]) == "--verbose") {
+			verbose = true;
+		} else if(std::string(argv[i]) == "--profile-check") {
+			goal_cascade.setEnabled("profile", true);
+		} else if((std::string(argv[i]) == "--free-space") && (i+1 < argc)) {
+			freeSpaceBins = std::max(0, atoi(argv[++i]));
+		} else if((std::string(argv[i]) == "--camera-height") && (i+1 < argc)) {
+			obs_cameraHeight = atof(argv[++i]);
+		} else if((std::string(argv[i]) == "--camera-tilt") && (i+1 < argc)) {
+			obs_cameraTilt = atof(argv[++i]);
+		}
+	}
+
+	// kill -USR1 dumps the per-stage latency histograms and scoring rejection counts
+	std::signal(SIGUSR1, profileDumpHandler);
+
 	// kick off all threads
 	serverThreads.discover = std::thread(disc_server);
 	serverThreads.periodic = std::thread(periodic);
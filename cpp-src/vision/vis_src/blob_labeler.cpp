@@ -0,0 +1,214 @@
+#include "blob_labeler.h"
+#include "contour_descriptor.h"
+#include "opencv2/core.hpp"
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+/*! \file blob_labeler.cpp
+ *  \brief Run-based connected-components labeling and blob measurement.
+ */
+
+int visproc_detectEngine = ENGINE_CONTOURS;
+
+void blob_features::outline(std::vector<cv::Point>& pts) const {
+	pts.resize(4);
+	pts[0] = cv::Point(bounds.x, bounds.y);
+	pts[1] = cv::Point(bounds.x + bounds.width - 1, bounds.y);
+	pts[2] = cv::Point(bounds.x + bounds.width - 1, bounds.y + bounds.height - 1);
+	pts[3] = cv::Point(bounds.x, bounds.y + bounds.height - 1);
+}
+
+int blob_labeler::newLabel() {
+	int l = parent.size();
+	parent.push_back(l);
+
+	accumulator a = {0, 0, 0, 0, 0, 0, INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+	accum.push_back(a);
+
+	return l;
+}
+
+int blob_labeler::find(int l) {
+	while(parent[l] != l) {
+		parent[l] = parent[parent[l]]; // path halving
+		l = parent[l];
+	}
+	return l;
+}
+
+/* The lower label always becomes the root, so blobs come out in the order of their first run. */
+void blob_labeler::unite(int a, int b) {
+	a = find(a);
+	b = find(b);
+	if(a < b) {
+		parent[b] = a;
+	} else if(b < a) {
+		parent[a] = b;
+	}
+}
+
+/* Sum of k^2 for k = 0..n (valid for negative n as well). */
+static inline double sumSquares(double n) {
+	return (n * (n+1) * ((2*n)+1)) / 6;
+}
+
+/* Add the pixels (x0..x1-1, y) to a label's statistics in closed form. */
+void blob_labeler::addRun(int y, int x0, int x1, int l) {
+	accumulator& a = accum[l];
+	double n = x1 - x0;
+	double sx = (n * (x0 + x1 - 1)) / 2;
+	double sxx = sumSquares(x1 - 1) - sumSquares(x0 - 1);
+
+	a.m00 += n;
+	a.m10 += sx;
+	a.m01 += n * y;
+	a.m20 += sxx;
+	a.m11 += sx * y;
+	a.m02 += n * y * y;
+
+	a.xMin = std::min(a.xMin, x0);
+	a.xMax = std::max(a.xMax, x1 - 1);
+	a.yMin = std::min(a.yMin, y);
+	a.yMax = std::max(a.yMax, y);
+}
+
+/* Join the runs in curRuns (row y) to the runs of the row above, and add them to their blobs' statistics. */
+void blob_labeler::labelRow(int y, cv::Point offset) {
+	size_t p = 0;
+
+	for(size_t i=0;i<curRuns.size();i++) {
+		run& r = curRuns[i];
+		r.label = -1;
+
+		/* Runs in the row above touch this one (diagonals included) if they span [x0-1, x1].
+		 * Both rows are sorted, so runs skipped here can't touch any later run either. */
+		while((p < prevRuns.size()) && (prevRuns[p].x1 < r.x0)) {
+			p++;
+		}
+
+		for(size_t q=p;(q < prevRuns.size()) && (prevRuns[q].x0 <= r.x1);q++) {
+			if(r.label < 0) {
+				r.label = prevRuns[q].label;
+			} else {
+				unite(r.label, prevRuns[q].label);
+			}
+		}
+
+		if(r.label < 0) {
+			r.label = newLabel();
+		}
+
+		addRun(y + offset.y, r.x0 + offset.x, r.x1 + offset.x, r.label);
+	}
+
+	std::swap(prevRuns, curRuns);
+}
+
+/*!	\fn blob_labeler::label(const cv::Mat& mask, cv::Point offset)
+ *	\brief Find the 8-connected blobs of nonzero pixels in a mask and measure them.
+ *
+ *	The mask is scanned once; each run of set pixels is joined to the runs it touches in the row
+ *	above, and its contribution to its blob's statistics is added in closed form. Afterwards the
+ *	statistics of labels that turned out to belong to the same blob are merged.
+ *	Results are available from blobs() until the next call.
+ *	\param mask Binary mask (CV_8U). May be a submatrix.
+ *	\param offset Added to all coordinates, e.g. to map a processed window back to frame coordinates.
+ */
+void blob_labeler::label(const cv::Mat& mask, cv::Point offset) {
+	CV_Assert(mask.type() == CV_8U);
+
+	prevRuns.clear();
+	parent.clear();
+	accum.clear();
+
+	for(int y=0;y<mask.rows;y++) {
+		const unsigned char* row = mask.ptr<unsigned char>(y);
+		int x = 0;
+
+		curRuns.clear();
+		while(x < mask.cols) {
+			if(!row[x]) {
+				x++;
+				continue;
+			}
+
+			run r;
+			r.x0 = x;
+			while((x < mask.cols) && row[x]) {
+				x++;
+			}
+			r.x1 = x;
+			curRuns.push_back(r);
+		}
+
+		labelRow(y, offset);
+	}
+
+	collect();
+}
+
+/*!	\fn blob_labeler::label(const rle_mask& mask, cv::Point offset)
+ *	\brief Find and measure the 8-connected blobs of a run-length encoded mask.
+ *
+ *	Same results as labeling the decoded mask, but only the stored runs are visited.
+ */
+void blob_labeler::label(const rle_mask& mask, cv::Point offset) {
+	prevRuns.clear();
+	parent.clear();
+	accum.clear();
+
+	for(int y=0;y<mask.size().height;y++) {
+		curRuns.clear();
+		for(const rle_run* rr=mask.rowBegin(y);rr != mask.rowEnd(y);++rr) {
+			run r;
+			r.x0 = rr->x0;
+			r.x1 = rr->x1;
+			curRuns.push_back(r);
+		}
+
+		labelRow(y, offset);
+	}
+
+	collect();
+}
+
+/* Merge the statistics of labels found to be connected, and build the results. */
+void blob_labeler::collect() {
+	results.clear();
+
+	/* Fold every label's statistics into its root */
+	for(size_t l=0;l<parent.size();l++) {
+		int root = find(l);
+		if(root == (int)l) {
+			continue;
+		}
+
+		accumulator& dst = accum[root];
+		const accumulator& src = accum[l];
+		dst.m00 += src.m00;
+		dst.m10 += src.m10;
+		dst.m01 += src.m01;
+		dst.m20 += src.m20;
+		dst.m11 += src.m11;
+		dst.m02 += src.m02;
+		dst.xMin = std::min(dst.xMin, src.xMin);
+		dst.xMax = std::max(dst.xMax, src.xMax);
+		dst.yMin = std::min(dst.yMin, src.yMin);
+		dst.yMax = std::max(dst.yMax, src.yMax);
+	}
+
+	for(size_t l=0;l<parent.size();l++) {
+		if(parent[l] != (int)l) {
+			continue;
+		}
+
+		const accumulator& a = accum[l];
+		blob_features f;
+		f.area = a.m00;
+		f.bounds = cv::Rect(a.xMin, a.yMin, (a.xMax - a.xMin) + 1, (a.yMax - a.yMin) + 1);
+		f.centroid = cv::Point2d(a.m10 / a.m00, a.m01 / a.m00);
+		f.moments = secondOrderMoments(a.m00, a.m10, a.m01, a.m20, a.m11, a.m02);
+		results.push_back(f);
+	}
+}
@@ -1,5 +1,7 @@
 #include "visproc_interface.h"
 #include "visproc_common.h"
+#include "target_pipeline.h"
+#include "multi_target.h"
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/imgcodecs.hpp"
@@ -12,109 +14,120 @@
 int ball_hueThres[2] = {0, 180};
 int ball_satThres[2] = {0, 35};
 int ball_valThres[2] = {80, 173};
-const double area_threshold = 500;
-
-cv::Mat boulder_preprocess_pipeline(cv::Mat input, bool suppress_output, bool live_output) {
-        cv::Mat tmp(input.size(), input.type());
-
-        cv::cvtColor(input, tmp, CV_BGR2HSV);
-
-        /* Make things easier for the HV filter */
-        //cv::blur(tmp, tmp, cv::Size(5,5));
-        cv::GaussianBlur(tmp, tmp, cv::Size(3,3), 1.5, 1.5, cv::BORDER_DEFAULT);
-		drawOut("stage1", tmp, live_output);
-
-        /* Filter on saturation and brightness */
-        cv::Mat mask(input.size(), CV_8U);
-        cv::inRange(tmp,
-					cv::Scalar((unsigned char)ball_hueThres[0],(unsigned char)ball_satThres[0],(unsigned char)ball_valThres[0]),
-					cv::Scalar((unsigned char)ball_hueThres[1],(unsigned char)ball_satThres[1],(unsigned char)ball_valThres[1]),
-					mask);
-		drawOut("stage2", mask, live_output);
-
-        /* Dilate away smaller hits */
-        cv::dilate(mask, mask, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5,5)));
-		drawOut("stage3", mask, live_output);
-
-        /* Blur for edge detection */
-        cv::Mat edgedet;
-        cv::blur(mask, edgedet, cv::Size(7,7));
-		drawOut("stage4", edgedet, live_output);
-
-        cv::Canny(edgedet, edgedet, cannyThresMin, cannyThresMin+cannyThresSize);
-		drawOut("stage5", edgedet, live_output);
-
-        return edgedet;
+hsv_color_lut ball_colorLUT;
+
+/*! \struct boulder_target
+ *  \brief target_pipeline.h policy for boulders.
+ */
+struct boulder_target {
+	static const int morphOp = cv::MORPH_DILATE;		//!< Fill in the gaps left by the ball's texture.
+	static const int morphSize = 5;
+	static const int blurSize = 7;
+	static const int hsvBlurSize = 3;
+	static constexpr double hsvBlurSigma = 1.5;
+	static const int hsvBlurBorder = cv::BORDER_DEFAULT;
+	static constexpr double minArea = 500;
+
+	static hsv_range range() {
+		return hsv_range(ball_hueThres[0], ball_hueThres[1], ball_satThres[0], ball_satThres[1], ball_valThres[0], ball_valThres[1]);
+	}
+	static hsv_color_lut& colorLUT() { return ball_colorLUT; }
+	static score_cascade& cascade() { return boulder_cascade; }
+
+	static double test(int t, const candidate_geometry& c, bool suppress_output);
+};
+
+/* Score one candidate on one cascade test; shared by the contour and blob engines. */
+double boulder_target::test(int t, const candidate_geometry& c, bool suppress_output) {
+            if(t == BOULDER_TEST_CIRCULARITY) {
+                double idealRadius = (c.bounds.width/2);
+                double idealArea = pi * (idealRadius * idealRadius);
+
+                double circularity = scoreDistanceFromTarget(idealArea, c.area);
+                if(!suppress_output) { std::cout << "Circularity Score: " << circularity << std::endl; }
+                return circularity;
+            } else if(t == BOULDER_TEST_ASPECT) {
+                double ar_score = scoreDistanceFromTarget(1, c.bounds.width / c.bounds.height);
+                if(!suppress_output) { std::cout << "AsRatio Score: " << ar_score << std::endl; }
+                return ar_score;
+            }
+            return 0;
 }
 
-std::vector<scoredContour> boulder_pipeline(cv::Mat input, bool suppress_output, bool window_output) {
-    std::vector< std::vector<cv::Point> > contours;
-
-    cv::Mat contourOut = input.clone();
+/*!	\fn boulder_target_class()
+ *	\brief The boulder target, for registering with a multi_target_detector.
+ */
+target_class boulder_target_class() {
+	return make_target_class<boulder_target>("boulder");
+}
 
-    cv::findContours(contourOut, contours, CV_RETR_LIST, CV_CHAIN_APPROX_NONE);
-    std::vector<scoredContour> finalscores;
+/*!	\fn boulder_preprocess_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output, bool live_output)
+ *	\brief Filter and edge-detect an image, searching for boulders.
+ *
+ *	\param input Input frame.
+ *	\param ctx Context holding the intermediate buffers; the returned Mat is ctx.edges
+ *	(or, with ENGINE_BLOBS, the dilated binary mask in ctx.blurred). With ENGINE_RLE, the dilated mask
+ *	stays run-length encoded in ctx.rleMorph, where boulder_pipeline picks it up, and the returned Mat is empty.
+ *	If ctx.preprocess is set, that pipeline is run instead of the built-in chain, and its output is returned.
+ *	\param suppress_output If false, then debugging data is written to stdout.
+ *	\param live_output If true, then intermediate pipeline image streams are output to GUI windows.
+ */
+cv::Mat& boulder_preprocess_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output, bool live_output) {
+        if(!suppress_output) { std::cout << "Preprocessing " << input.cols << "x" << input.rows << " frame" << std::endl; }
+
+        target_update_lut<boulder_target>();
+        return target_preprocess_window<boulder_target>(input, ctx, live_output);
+}
 
-    std::cout << "Found " << contours.size() << " contours." << std::endl;
+cv::Mat boulder_preprocess_pipeline(cv::Mat input, bool suppress_output, bool live_output) {
+        visproc_context ctx;
+        cv::Mat& out = boulder_preprocess_pipeline(input, ctx, suppress_output, live_output);
+
+        /* The context is about to go away, so hand back a decoded mask */
+        if(visproc_detectEngine == ENGINE_RLE) {
+            ctx.rleMorph.toMat(out);
+        }
+        return out;
+}
 
-	if(window_output) {
-		cv::Mat conOut = cv::Mat::zeros(input.size(), CV_8UC3);
-		for(int i=0;i<contours.size();i++) {
-			double area = cv::contourArea(contours[i]);
-			if(area < area_threshold) {
-                continue;
-            }
-			cv::Scalar col(rand()&180, rand()&255, rand()&255);
-			cv::drawContours(conOut, contours, i, col, CV_FILLED, 8);
+/*!	\fn boulder_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output, bool window_output)
+ *	\brief Score all boulder candidates in a preprocessed image.
+ *
+ *	With ENGINE_BLOBS or ENGINE_RLE, each result's point list is the candidate's bounding box as a 4-point contour.
+ *	With ENGINE_RLE, the mask is read from ctx.rleMorph and input is ignored.
+ *	\param input Preprocessed frame from boulder_preprocess_pipeline.
+ *	\param ctx Context holding the contour stores; the returned reference is ctx.results (also in ctx.detections), sorted best first
+ *	and limited to the best ctx.maxResults.
+ *	\param suppress_output If false, then debugging data is written to stdout.
+ *	\param window_output If true, then detected contours are output to a GUI window.
+ */
+const std::vector<scoredContour>& boulder_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output, bool window_output) {
+    ctx.clearCandidates();
+    target_score<boulder_target>(input, cv::Point(), ctx, suppress_output, window_output, ctx.maxResults);
+
+	if(selectTopScores(ctx.scores, ctx.maxResults) > 0) {
+		/* resize() + copyTo() reuse the point storage left over from previous frames */
+		ctx.detections.resize(ctx.scores.size());
+		ctx.results.resize(ctx.scores.size());
+		for(size_t i=0;i<ctx.scores.size();i++) {
+			ctx.detections[i] = target_record(ctx, ctx.scores[i]);
+			ctx.results[i].first = ctx.scores[i].first;
+			ctx.arena.copyTo(ctx.detections[i], ctx.results[i].second);
 		}
-		drawOut("contours", conOut, window_output);
+	} else {
+		ctx.detections.clear();
+		ctx.results.resize(1);
+		ctx.results[0].first = 0.0;
+		ctx.results[0].second.clear();
 	}
 
-    unsigned int ctr = 0;
-    for(std::vector< std::vector<cv::Point> >::iterator i = contours.begin();
-        i != contours.end(); ++i) {
-            ctr++;
-            double area = cv::contourArea(*i);
-            double perimeter = cv::arcLength(*i, true);
-            cv::Rect bounds = cv::boundingRect(*i);
-
-            if(area < area_threshold) {
-                continue;
-            }
-
-			if(!suppress_output) {
-		        std::cout << std::endl;
-		        std::cout << "Contour " << ctr << ": " << std::endl;
-		        ctr++;
-		        std::cout << "Area: "  << area << std::endl;
-		        std::cout << "Perimeter: " << perimeter << std::endl;
-			}
-
-            double idealRadius = (bounds.width/2);
-            double idealArea = pi * (idealRadius * idealRadius);
-
-            double circularity = scoreDistanceFromTarget(idealArea, area);
-            double ar_score = scoreDistanceFromTarget(1, bounds.width / bounds.height);
-
-            double total_score = (circularity + ar_score) / 2;
-	
-			if(!suppress_output) {
-		        std::cout << "Circularity Score: " << circularity << std::endl;
-		        std::cout << "AsRatio Score: " << ar_score << std::endl;
-		        std::cout << "Total Score: " << total_score << std::endl;
-			}
+	return ctx.results;
+}
 
-            finalscores.push_back(std::make_pair(total_score, std::move(*i)));
+std::vector<scoredContour> boulder_pipeline(cv::Mat input, bool suppress_output, bool window_output) {
+    visproc_context ctx;
+    if(visproc_detectEngine == ENGINE_RLE) {
+        ctx.rleMorph.fromMat(input);
     }
-
-	if(finalscores.size() > 0) {
-    	std::sort(finalscores.begin(), finalscores.end(), &scoresort);
-		std::reverse(finalscores.begin(), finalscores.end());
-
-    	return finalscores;
-	} else {
-		std::vector<scoredContour> ret;
-		ret.push_back(std::make_pair(0.0, std::vector<cv::Point>()));
-		return ret;
-	}
+    return boulder_pipeline(input, ctx, suppress_output, window_output);
 }
@@ -0,0 +1,192 @@
+#include "camera_model.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+/*! \file camera_model.cpp
+ *  \brief Calibration loading and ray table construction for camera_model.
+ */
+
+camera_model visproc_camera;
+
+/*!	\fn camera_model::load(const std::string& path)
+ *	\brief Read intrinsics and distortion coefficients from a calibration file (see camera_model.h for the format).
+ *
+ *	Tables are built for the calibration resolution; call setResolution() if frames differ. Errors are reported on stderr.
+ *	\return false if the file could not be read, in which case the model is left uncalibrated.
+ */
+bool camera_model::load(const std::string& path) {
+	cameraMatrix.release();
+	distCoeffs.release();
+
+	cv::FileStorage fs(path, cv::FileStorage::READ);
+	if(!fs.isOpened()) {
+		std::cerr << "Could not open calibration file " << path << std::endl;
+		return false;
+	}
+
+	cv::Mat K, D;
+	fs["camera_matrix"] >> K;
+	fs["distortion_coefficients"] >> D;
+	int w = 0;
+	int h = 0;
+	fs["image_width"] >> w;
+	fs["image_height"] >> h;
+
+	if((K.rows != 3) || (K.cols != 3) || (w <= 0) || (h <= 0)) {
+		std::cerr << path << ": expected camera_matrix (3x3), image_width and image_height" << std::endl;
+		return false;
+	}
+
+	K.convertTo(cameraMatrix, CV_64F);
+	if(!D.empty()) {
+		D.convertTo(distCoeffs, CV_64F);
+	}
+	calibSize = cv::Size(w, h);
+
+	size = cv::Size();
+	setResolution(calibSize);
+	return true;
+}
+
+/*!	\fn camera_model::setIdeal(cv::Size sz, double hfov, double vfov)
+ *	\brief Model an ideal (distortion-free) camera with the given fields of view, in radians, for frames of size sz.
+ *
+ *	For code that needs the model's tables whether or not a calibration file has been loaded; visproc_camera
+ *	itself should only be loaded from a file, since the geometry helpers take calibrated() to mean that.
+ */
+void camera_model::setIdeal(cv::Size sz, double hfov, double vfov) {
+	cameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+	cameraMatrix.at<double>(0, 0) = (sz.width / 2.0) / std::tan(hfov / 2);
+	cameraMatrix.at<double>(1, 1) = (sz.height / 2.0) / std::tan(vfov / 2);
+	cameraMatrix.at<double>(0, 2) = sz.width / 2.0;
+	cameraMatrix.at<double>(1, 2) = sz.height / 2.0;
+	distCoeffs.release();
+	calibSize = sz;
+
+	size = cv::Size();
+	setResolution(sz);
+}
+
+/*!	\fn camera_model::setResolution(cv::Size sz)
+ *	\brief Build the lookup tables for frames of the given size; does nothing if they already match.
+ */
+void camera_model::setResolution(cv::Size sz) {
+	if(!calibrated() || (sz == size)) {
+		return;
+	}
+	size = sz;
+
+	/* Same field of view at a different resolution: scale the focal lengths and principal point */
+	cv::Mat K = cameraMatrix.clone();
+	double sx = (double)sz.width / calibSize.width;
+	double sy = (double)sz.height / calibSize.height;
+	K.at<double>(0, 0) *= sx;
+	K.at<double>(0, 2) *= sx;
+	K.at<double>(1, 1) *= sy;
+	K.at<double>(1, 2) *= sy;
+
+	double cx = K.at<double>(0, 2);
+	double cy = K.at<double>(1, 2);
+
+	/* Columns along the center row, then rows along the center column, undistorted in one call */
+	std::vector<cv::Point2f> px;
+	px.reserve(sz.width + sz.height + 2);
+	for(int x=0;x<=sz.width;x++) {
+		px.push_back(cv::Point2f(x, cy));
+	}
+	for(int y=0;y<=sz.height;y++) {
+		px.push_back(cv::Point2f(cx, y));
+	}
+
+	std::vector<cv::Point2f> rays;
+	cv::undistortPoints(px, rays, K, distCoeffs);
+
+	colTan.resize(sz.width + 1);
+	colAngles.resize(sz.width + 1);
+	for(int x=0;x<=sz.width;x++) {
+		colTan[x] = rays[x].x;
+		colAngles[x] = std::atan(colTan[x]);
+	}
+
+	rowTan.resize(sz.height + 1);
+	rowAngles.resize(sz.height + 1);
+	for(int y=0;y<=sz.height;y++) {
+		rowTan[y] = rays[sz.width + 1 + y].y;
+		rowAngles[y] = std::atan(rowTan[y]);
+	}
+}
+
+/* Linear interpolation in a table indexed by pixel coordinate; clamped to its ends. */
+double camera_model::lookup(const std::vector<double>& table, double p) {
+	if(p <= 0) {
+		return table.front();
+	}
+
+	size_t i = (size_t)p;
+	if(i >= table.size() - 1) {
+		return table.back();
+	}
+
+	double f = p - i;
+	return table[i] + (f * (table[i+1] - table[i]));
+}
+
+/*!	\fn camera_model::distanceFromRows(double top, double bottom, double targetHeight)
+ *	\brief Distance along the optical axis to an upright target of known height spanning the given rows.
+ *	\return The distance in targetHeight's units, or -1 if bottom is not below top.
+ */
+double camera_model::distanceFromRows(double top, double bottom, double targetHeight) const {
+	double span = lookup(rowTan, bottom) - lookup(rowTan, top);
+	return (span > 0) ? (targetHeight / span) : -1;
+}
+
+/*!	\fn camera_model::distanceFromColumns(double left, double right, double targetWidth)
+ *	\brief Distance along the optical axis to a target of known width, facing the camera, spanning the given columns.
+ *	\return The distance in targetWidth's units, or -1 if right is not right of left.
+ */
+double camera_model::distanceFromColumns(double left, double right, double targetWidth) const {
+	double span = lookup(colTan, right) - lookup(colTan, left);
+	return (span > 0) ? (targetWidth / span) : -1;
+}
+
+/*!	\fn camera_model::projectToGroundPlane(cv::Point2f imgPoint, double cameraHeight, double cameraTilt)
+ *	\brief Ground position (lateral, forward) of an image point, for a camera cameraHeight above the ground
+ *	and tilted cameraTilt radians downwards.
+ *
+ *	The point's ray is (u, v, 1) in camera coordinates, with u and v from the column and row tables. Tilted
+ *	down by t, it points cos t - v sin t forwards and sin t + v cos t downwards, so it meets the ground at
+ *	forward = height / tan(a + t) (with tan(a) = v), and at lateral / forward = u / (cos t (1 - v tan t)).
+ *	Points at or above the horizon have no ground position; their forward distance is returned as infinity.
+ */
+std::pair<double, double> camera_model::projectToGroundPlane(cv::Point2f imgPoint, double cameraHeight, double cameraTilt) const {
+	/* tan(a + tilt) without evaluating tan(a): tan(a) is the table entry */
+	double ta = lookup(rowTan, imgPoint.y);
+	double tt = std::tan(cameraTilt);
+	double denom = 1 - (ta * tt);
+
+	/* denom <= 0: the ray points straight down or behind the camera */
+	if((denom <= 0) || ((ta + tt) <= 0)) {
+		return std::make_pair(0.0, HUGE_VAL);
+	}
+
+	double y = (cameraHeight * denom) / (ta + tt);
+	double x = (y * lookup(colTan, imgPoint.x)) / (std::cos(cameraTilt) * denom);
+	return std::make_pair(x, y);
+}
+
+/*!	\fn camera_model::horizFOV()
+ *	\brief Horizontal field of view at the current resolution, in radians.
+ */
+double camera_model::horizFOV() const {
+	return colAngles.back() - colAngles.front();
+}
+
+/*!	\fn camera_model::vertFOV()
+ *	\brief Vertical field of view at the current resolution, in radians.
+ */
+double camera_model::vertFOV() const {
+	return rowAngles.back() - rowAngles.front();
+}
@@ -0,0 +1,49 @@
+#include "change_detector.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+/*! \file change_detector.cpp
+ *  \brief Thumbnail comparison for frame_change_detector.
+ */
+
+/*!	\fn frame_change_detector::changed(const cv::Mat& frame)
+ *	\brief Decide whether a frame needs processing.
+ *
+ *	Returns true for the first frame, after a change in frame size or type, once maxSkipped frames in a row
+ *	have been skipped, or if the frame differs from the last changed frame by more than the thresholds.
+ *	A frame reported as changed becomes the new reference.
+ */
+bool frame_change_detector::changed(const cv::Mat& frame) {
+	cv::resize(frame, thumb, thumbSize, 0, 0, cv::INTER_AREA);
+
+	bool accept = reference.empty() || (reference.size() != thumb.size()) || (reference.type() != thumb.type()) || (skipped >= maxSkipped);
+
+	if(!accept) {
+		cv::absdiff(thumb, reference, diff);
+
+		cv::Scalar sums = cv::sum(diff);
+		double mean = (sums[0] + sums[1] + sums[2] + sums[3]) / ((double)diff.total() * diff.channels());
+
+		double maxDiff = 0;
+		cv::minMaxLoc(diff.reshape(1), NULL, &maxDiff);
+
+		accept = (mean > meanThreshold) || (maxDiff > cellThreshold);
+	}
+
+	if(accept) {
+		cv::swap(thumb, reference);
+		skipped = 0;
+	} else {
+		skipped++;
+	}
+
+	return accept;
+}
+
+/*!	\fn frame_change_detector::reset()
+ *	\brief Forget the reference frame, so that the next frame is reported as changed.
+ */
+void frame_change_detector::reset() {
+	reference.release();
+	skipped = 0;
+}
@@ -0,0 +1,205 @@
+#include "color_lut.h"
+#include "hsv_threshold.h"
+#include "opencv2/core.hpp"
+#include <algorithm>
+
+/*! \file color_lut.cpp
+ *  \brief Lookup-table based HSV color classifier.
+ */
+
+hsv_color_lut::~hsv_color_lut() {
+	std::lock_guard<std::mutex> guard(lock);
+	if(building) {
+		builder.join();
+	}
+}
+
+/* Wait for the background build, if any, and swap its table in. Must be called with lock held. */
+void hsv_color_lut::finishBuild() {
+	builder.join();
+	building = false;
+	table = pending;
+	built = pendingRange;
+	pending.reset();
+}
+
+/*!	\fn hsv_color_lut::update(const hsv_range& range)
+ *	\brief Make sure the table reflects the given bounds, rebuilding it only if they changed.
+ *
+ *	Cheap enough to call once per frame with the current threshold values. If there is no table yet (or
+ *	asyncRebuild is off), it is built before returning; otherwise a changed range is built in the
+ *	background, and the old table stays in use until a later call finds the new one finished.
+ *	\returns True if a new table was put in use.
+ */
+bool hsv_color_lut::update(const hsv_range& range) {
+	std::lock_guard<std::mutex> guard(lock);
+
+	bool swapped = false;
+	if(building && pendingDone.load(std::memory_order_acquire)) {
+		finishBuild();
+		swapped = true;
+	}
+
+	if(table && (range == built)) {
+		return swapped;
+	}
+
+	if(!table || !asyncRebuild) { // nothing to fall back on (or asked not to): build it now
+		if(building) {
+			finishBuild();
+			if(range == built) {
+				return true;
+			}
+		}
+
+		std::shared_ptr<lut_table> t = std::make_shared<lut_table>();
+		build(resolution, range, *t);
+		table = t;
+		built = range;
+		return true;
+	}
+
+	/* One build at a time; if the range changed again meanwhile, the next call after it finishes starts another */
+	if(!building) {
+		pending = std::make_shared<lut_table>();
+		pendingRange = range;
+		pendingDone.store(false, std::memory_order_relaxed);
+		building = true;
+
+		lut_table* out = pending.get();
+		lut_resolution res = resolution;
+		builder = std::thread([this, out, res, range]() {
+			build(res, range, *out);
+			pendingDone.store(true, std::memory_order_release);
+		});
+	}
+
+	return swapped;
+}
+
+/*!	\fn hsv_color_lut::invalidate()
+ *	\brief Drop the table (waiting for any background build), so that the next update() rebuilds it in place.
+ */
+void hsv_color_lut::invalidate() {
+	std::lock_guard<std::mutex> guard(lock);
+	if(building) {
+		builder.join();
+		building = false;
+		pending.reset();
+	}
+	table.reset();
+}
+
+/*!	\fn hsv_color_lut::getRange()
+ *	\brief Bounds of the table currently in use.
+ */
+hsv_range hsv_color_lut::getRange() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return built;
+}
+
+std::shared_ptr<const hsv_color_lut::lut_table> hsv_color_lut::current() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return table;
+}
+
+void hsv_color_lut::build(lut_resolution res, const hsv_range& range, lut_table& out) {
+	if(res == LUT_BGR565) {
+		build565(range, out);
+	} else {
+		build888(range, out);
+	}
+}
+
+void hsv_color_lut::build888(const hsv_range& range, lut_table& out) {
+	out.assign((1 << 24) / 8, 0);
+
+	unsigned char bgr[3];
+	unsigned char hsv[3];
+	uint32_t idx = 0;
+	for(int b=0;b<256;b++) {
+		bgr[0] = b;
+		for(int g=0;g<256;g++) {
+			bgr[1] = g;
+			for(int r=0;r<256;r++, idx++) {
+				bgr[2] = r;
+				bgrToHSV8U(bgr, hsv);
+				if(range.contains(hsv)) {
+					out[idx >> 3] |= (1 << (idx & 7));
+				}
+			}
+		}
+	}
+}
+
+void hsv_color_lut::build565(const hsv_range& range, lut_table& out) {
+	out.assign(1 << 16, 0);
+
+	unsigned char bgr[3];
+	unsigned char hsv[3];
+	for(int b=0;b<32;b++) {
+		bgr[0] = (b << 3) | 4;
+		for(int g=0;g<64;g++) {
+			bgr[1] = (g << 2) | 2;
+			for(int r=0;r<32;r++) {
+				bgr[2] = (r << 3) | 4;
+				bgrToHSV8U(bgr, hsv);
+				out[(b << 11) | (g << 5) | r] = range.contains(hsv) ? 1 : 0;
+			}
+		}
+	}
+}
+
+/*!	\fn hsv_color_lut::apply(const cv::Mat& bgr, cv::Mat& mask)
+ *	\brief Classify every pixel of a BGR frame, writing a 0 / 255 mask.
+ *
+ *	\param bgr Input frame (CV_8UC3, BGR order). May be a submatrix.
+ *	\param mask Output mask (CV_8U).
+ */
+void hsv_color_lut::apply(const cv::Mat& bgr, cv::Mat& mask) const {
+	std::shared_ptr<const lut_table> t = current();
+	CV_Assert(t && (bgr.type() == CV_8UC3));
+	const uint8_t* lut = t->data();
+	mask.create(bgr.size(), CV_8U);
+
+	for(int y=0;y<bgr.rows;y++) {
+		const unsigned char* in = bgr.ptr<unsigned char>(y);
+		unsigned char* out = mask.ptr<unsigned char>(y);
+
+		for(int x=0;x<bgr.cols;x++, in+=3) {
+			out[x] = classify(lut, in[0], in[1], in[2]) ? 255 : 0;
+		}
+	}
+}
+
+/*!	\fn hsv_color_lut::apply(const cv::Mat& bgr, rle_mask& mask)
+ *	\brief Classify every pixel of a BGR frame, encoding the matches directly as runs.
+ *
+ *	\param bgr Input frame (CV_8UC3, BGR order). May be a submatrix.
+ *	\param mask Output mask.
+ */
+void hsv_color_lut::apply(const cv::Mat& bgr, rle_mask& mask) const {
+	std::shared_ptr<const lut_table> t = current();
+	CV_Assert(t && (bgr.type() == CV_8UC3));
+	const uint8_t* lut = t->data();
+	mask.reset(bgr.size());
+
+	for(int y=0;y<bgr.rows;y++) {
+		const unsigned char* in = bgr.ptr<unsigned char>(y);
+		int x = 0;
+
+		while(x < bgr.cols) {
+			if(!classify(lut, in[3*x], in[(3*x)+1], in[(3*x)+2])) {
+				x++;
+				continue;
+			}
+
+			int x0 = x++;
+			while((x < bgr.cols) && classify(lut, in[3*x], in[(3*x)+1], in[(3*x)+2])) {
+				x++;
+			}
+			mask.appendRun(y, x0, x);
+		}
+		mask.endRow(y);
+	}
+}
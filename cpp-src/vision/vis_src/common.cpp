@@ -14,6 +14,39 @@ bool scoresort(scoredContour c1, scoredContour c2) {
         return (c1.first < c2.first);
 }
 
+bool indexscoresort(const scoredIndex& c1, const scoredIndex& c2) {
+        return (c1.first < c2.first);
+}
+
+/* Best first; equal scores keep their candidate order, so results don't depend on the selection algorithm. */
+static bool indexscorebetter(const scoredIndex& c1, const scoredIndex& c2) {
+        return (c1.first > c2.first) || ((c1.first == c2.first) && (c1.second < c2.second));
+}
+
+/*!	\fn selectTopScores(std::vector<scoredIndex>& scores, size_t k)
+ *	\brief Keep only the k best entries of scores, sorted best first.
+ *
+ *	k = 1 is a single linear scan; otherwise a partial sort (O(n log k)) orders just the winners.
+ *	Ties go to the lower index. k = 0 keeps (and sorts) every entry.
+ *	\return The number of entries kept.
+ */
+size_t selectTopScores(std::vector<scoredIndex>& scores, size_t k) {
+        if((k == 0) || (k > scores.size())) {
+                k = scores.size();
+        }
+
+        if(k == 1) {
+                std::iter_swap(scores.begin(), std::min_element(scores.begin(), scores.end(), &indexscorebetter));
+        } else if(k < scores.size()) {
+                std::partial_sort(scores.begin(), scores.begin() + k, scores.end(), &indexscorebetter);
+        } else {
+                std::sort(scores.begin(), scores.end(), &indexscorebetter);
+        }
+
+        scores.resize(k);
+        return k;
+}
+
 double scoreDistanceFromTarget(const double target, double value) {
         double distanceRatio = (fabs(target - fabs(target - value)) / target);
         return fmax(0, fmin(distanceRatio*100, 100));
@@ -21,6 +54,12 @@ double scoreDistanceFromTarget(const double target, double value) {
 
 /* fovWidth = width of input image in pixels */
 double getDistance(cv::Size observedSize, cv::Size targetSize, cv::Size fovSize) {
+	if(visproc_camera.calibrated()) { // assumes the target is centered
+		visproc_camera.setResolution(fovSize);
+		double c = fovSize.width / 2.0;
+		return visproc_camera.distanceFromColumns(c - (observedSize.width / 2.0), c + (observedSize.width / 2.0), targetSize.width);
+	}
+
 	double dW = (targetSize.width * fovSize.width) / (observedSize.width * tan(fovHoriz));
 	//double dH = targetSize.height * fovSize.height / (observedSize.height * tan(fovVert));
 
@@ -29,19 +68,61 @@ double getDistance(cv::Size observedSize, cv::Size targetSize, cv::Size fovSize)
 	//return ((dW + dH) / 2.0); // returns feet
 }
 
+/* Distance to a goal, from its observed size */
+double getDistance(cv::Size observedSize, cv::Size fovSize) {
+	return getDistance(observedSize, goalSz, fovSize);
+}
+
 double getDistance(double observedHeight, double targetHeight, double frameHeight, double fovAngle) {
+	if(visproc_camera.calibrated() && (visproc_camera.getResolution().height == frameHeight)) { // assumes the target is centered
+		double c = frameHeight / 2;
+		return visproc_camera.distanceFromRows(c - (observedHeight / 2), c + (observedHeight / 2), targetHeight);
+	}
+
 	return (targetHeight * frameHeight) / (observedHeight * tan(fovAngle)); // tan(fovAngle) = (frameHeight[px/ft] / distance[px/ft]);
 }
 
 double getAngleOffCenter(double midpointX, double frameWidth, double fovAngle) {
+	if(visproc_camera.calibrated() && (visproc_camera.getResolution().width == frameWidth)) {
+		return visproc_camera.columnAngle(midpointX);
+	}
+
 	return ((midpointX - (frameWidth/2)) / (frameWidth/2)) * (fovAngle/2);
 }
 
+/* Distance to an upright target of known height from its bounding box; lens-corrected once visproc_camera is calibrated. */
+double getDistance(const cv::Rect& bounds, double targetHeight, cv::Size frameSz) {
+	if(visproc_camera.calibrated()) {
+		visproc_camera.setResolution(frameSz);
+		return visproc_camera.distanceFromRows(bounds.y, bounds.y + bounds.height, targetHeight);
+	}
+
+	return getDistance(bounds.height, targetHeight, frameSz.height, fovVert);
+}
+
+/* Horizontal angle to the middle of a bounding box; lens-corrected once visproc_camera is calibrated. */
+double getAngleOffCenter(const cv::Rect& bounds, cv::Size frameSz) {
+	visproc_camera.setResolution(frameSz);
+	return getAngleOffCenter(bounds.x + (bounds.width/2), frameSz.width, fovHoriz);
+}
+
+/* Field of view, estimated from a target of known size at a known distance; once visproc_camera is calibrated,
+ * its field of view at this resolution is known, and returned as-is. */
 double getFOVAngleHoriz(cv::Size observedSize, cv::Size targetSize, cv::Size fovSize, double distance) {
+	if(visproc_camera.calibrated()) {
+		visproc_camera.setResolution(fovSize);
+		return visproc_camera.horizFOV();
+	}
+
 	return atan2(targetSize.width * fovSize.width, observedSize.width * distance);
 }
 
 double getFOVAngleVert(cv::Size observedSize, cv::Size targetSize, cv::Size fovSize, double distance) {
+	if(visproc_camera.calibrated()) {
+		visproc_camera.setResolution(fovSize);
+		return visproc_camera.vertFOV();
+	}
+
 	return atan2(targetSize.height * fovSize.height, observedSize.height * distance);
 }
 
@@ -52,3 +133,38 @@ double getAngleOffCenterline(cv::Size targetSz, cv::Size obsSz) {
 
 	return 90.0 * ASdiff;
 }
+
+/* returns angle off center horizontal and angle off center vertical, from the detection's own measurements */
+std::pair<double, double> getRelativeAngleOffCenter(const contour_record& object, cv::Size fovSize, double distance) {
+	std::pair<double, double> out;
+
+	cv::Point2d c = object.centroid();
+	double cX = c.x;
+	double cY = c.y;
+
+	const cv::Rect& bounds = object.bounds;
+
+	double xAxis = fovSize.height / 2;
+	double yAxis = fovSize.width / 2;
+
+	out.first = asin(abs(yAxis - cX) / distance);
+	out.second = asin(abs(xAxis - bounds.br().y) / distance);
+
+	if(cX > yAxis) { // right of center
+		out.first *= -1;
+	}
+
+	if(cY > xAxis) { // below center
+		out.second *= -1;
+	}
+
+	return out;
+}
+
+/* As above, for a bare point list; measures it first. */
+std::pair<double, double> getRelativeAngleOffCenter(scoredContour object, cv::Size fovSize, double distance) {
+	contour_record r;
+	describeContour(object.second, r);
+	r.score = object.first;
+	return getRelativeAngleOffCenter(r, fovSize, distance);
+}
@@ -0,0 +1,184 @@
+#include "contour_arena.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "opencv2/imgproc/imgproc_c.h"
+#include <algorithm>
+
+/*! \file contour_arena.cpp
+ *  \brief Contour tracing into a contour_arena.
+ */
+
+contour_arena::contour_arena(const contour_arena& other) : points(other.points), spans(other.spans), overLimit(other.overLimit) {}
+
+contour_arena& contour_arena::operator=(const contour_arena& other) {
+	points = other.points;
+	spans = other.spans;
+	overLimit = other.overLimit;
+	return *this;
+}
+
+contour_arena::~contour_arena() {
+	if(storage != NULL) {
+		cvReleaseMemStorage(&storage);
+	}
+}
+
+/*!	\fn contour_arena::clear()
+ *	\brief Forget every contour and record, and the degraded flag, keeping the buffers' capacity.
+ */
+void contour_arena::clear() {
+	points.clear();
+	spans.clear();
+	overLimit = false;
+}
+
+/*!	\fn contour_arena::extract(cv::Mat& image, cv::Point offset, int scale, bool externalOnly)
+ *	\brief Trace every contour in a binary image and add them to the arena.
+ *
+ *	Equivalent to cv::findContours(image, contours, CV_RETR_LIST, CV_CHAIN_APPROX_NONE, offset), and the
+ *	contours come out in the same order. Like findContours, this modifies image.
+ *	\param image 8-bit single channel image; nonzero pixels are treated as 1.
+ *	\param offset Added to every point, e.g. to map a window back into frame coordinates.
+ *	\param scale Every point is multiplied by this before offset is added, for subsampled images.
+ *	\param externalOnly If true, only outer contours are traced (as with CV_RETR_EXTERNAL), not the holes in them.
+ *	\return The number of contours added; they are numbered from the size() before the call.
+ */
+size_t contour_arena::extract(cv::Mat& image, cv::Point offset, int scale, bool externalOnly) {
+	CV_Assert(image.type() == CV_8UC1);
+
+	if(storage == NULL) {
+		storage = cvCreateMemStorage(0);
+	} else {
+		cvClearMemStorage(storage);
+	}
+
+	CvMat cimage = cvMat(image.rows, image.cols, CV_8UC1, image.data);
+	cimage.step = (int)image.step;
+
+	CvSeq* seq = NULL;
+	cv::Point traceOffset = (scale == 1) ? offset : cv::Point();
+	int mode = externalOnly ? CV_RETR_EXTERNAL : CV_RETR_LIST;
+	cvFindContours(&cimage, storage, &seq, sizeof(CvContour), mode, CV_CHAIN_APPROX_NONE, cvPoint(traceOffset.x, traceOffset.y));
+
+	/* With CV_RETR_LIST or CV_RETR_EXTERNAL every contour is on the top level, linked through h_next */
+	size_t first = spans.size();
+	size_t firstPoint = points.size();
+	for(;seq != NULL;seq = seq->h_next) {
+		span s = { (uint32_t)points.size(), (uint32_t)seq->total, (uint32_t)scale };
+		points.resize(points.size() + s.length);
+		cvCvtSeqToArray(seq, &points[s.offset]);
+		spans.push_back(s);
+	}
+
+	if(scale != 1) {
+		for(size_t i=firstPoint;i<points.size();i++) {
+			points[i] = (points[i] * scale) + offset;
+		}
+	}
+
+	return spans.size() - first;
+}
+
+/* Halve a binary image in place: each output pixel is the maximum of its 2x2 block (clamped at the far edges),
+ * and img becomes a view of its own top left corner. Every read is at or after the pixel being written. */
+static void maxHalve(cv::Mat& img) {
+	const int rows = (img.rows + 1) / 2;
+	const int cols = (img.cols + 1) / 2;
+	for(int y=0;y<rows;y++) {
+		const uchar* r0 = img.ptr<uchar>(2*y);
+		const uchar* r1 = img.ptr<uchar>(std::min((2*y) + 1, img.rows - 1));
+		uchar* out = img.ptr<uchar>(y);
+		for(int x=0;x<cols;x++) {
+			const int x1 = std::min((2*x) + 1, img.cols - 1);
+			out[x] = std::max(std::max(r0[2*x], r0[x1]), std::max(r1[2*x], r1[x1]));
+		}
+	}
+	img = img(cv::Rect(0, 0, cols, rows));
+}
+
+/*!	\fn contour_arena::extractBounded(const cv::Mat& image, cv::Mat& work, cv::Point offset, const contour_limits& limits)
+ *	\brief As extract(), but with the work capped by limits (see contour_limits); image is left unmodified.
+ *	\param work Scratch image, reused across calls.
+ *	\return The number of contours added.
+ */
+size_t contour_arena::extractBounded(const cv::Mat& image, cv::Mat& work, cv::Point offset, const contour_limits& limits) {
+	size_t first = spans.size();
+
+	size_t edgePixels = (limits.maxEdgePixels > 0) ? cv::countNonZero(image) : 0;
+	if(edgePixels > limits.maxEdgePixels) {
+		overLimit = true;
+		if(!limits.subsample) {
+			return 0;
+		}
+
+		/* Each output pixel is set if any pixel of its block is, so thin edges stay connected at any scale.
+		 * Thin edges only shrink in proportion to the scale, so keep halving until under the cap. */
+		image.copyTo(work);
+		cv::Mat small = work;
+		int scale = 1;
+		do {
+			scale *= 2;
+			maxHalve(small);
+		} while(((size_t)cv::countNonZero(small) > limits.maxEdgePixels) && (small.rows > 1) && (small.cols > 1));
+
+		extract(small, offset, scale);
+	} else {
+		image.copyTo(work);
+		extract(work, offset);
+	}
+
+	if(limits.maxContourPoints > 0) {
+		size_t kept = first;
+		for(size_t i=first;i<spans.size();i++) {
+			if(spans[i].length <= limits.maxContourPoints) {
+				spans[kept++] = spans[i];
+			}
+		}
+		if(kept < spans.size()) {
+			overLimit = true;
+			spans.resize(kept);
+		}
+	}
+
+	if((limits.maxContours > 0) && ((spans.size() - first) > limits.maxContours)) {
+		overLimit = true;
+
+		/* Keep the longest, then put them back in tracing order */
+		std::vector<span>::iterator begin = spans.begin() + first;
+		std::nth_element(begin, begin + limits.maxContours, spans.end(),
+			[](const span& a, const span& b) { return (a.length > b.length) || ((a.length == b.length) && (a.offset < b.offset)); });
+		spans.resize(first + limits.maxContours);
+		std::sort(spans.begin() + first, spans.end(), [](const span& a, const span& b) { return a.offset < b.offset; });
+	}
+
+	return spans.size() - first;
+}
+
+/*!	\fn contour_arena::append(const std::vector<cv::Point>& pts)
+ *	\brief Add a point list (e.g. a blob outline) to the buffer without registering it as a contour.
+ *	\return Its offset, for a contour_record.
+ */
+uint32_t contour_arena::append(const std::vector<cv::Point>& pts) {
+	uint32_t offset = points.size();
+	points.insert(points.end(), pts.begin(), pts.end());
+	return offset;
+}
+
+/*!	\fn contour_arena::record(size_t i, double score, const contour_descriptor& d)
+ *	\brief Make a contour_record for contour i, given its measurements (see describeContour()).
+ */
+contour_record contour_arena::record(size_t i, double score, const contour_descriptor& d) const {
+	contour_record r;
+	static_cast<contour_descriptor&>(r) = d;
+	r.score = score;
+	r.offset = spans[i].offset;
+	r.length = spans[i].length;
+	return r;
+}
+
+/*!	\fn contour_arena::copyTo(const contour_record& r, std::vector<cv::Point>& out)
+ *	\brief Copy a record's points out of the arena; assign() reuses out's existing capacity.
+ */
+void contour_arena::copyTo(const contour_record& r, std::vector<cv::Point>& out) const {
+	out.assign(points.begin() + r.offset, points.begin() + r.offset + r.length);
+}
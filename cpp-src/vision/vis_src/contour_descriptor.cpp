@@ -0,0 +1,81 @@
+#include "contour_descriptor.h"
+#include "opencv2/core.hpp"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+/*! \file contour_descriptor.cpp
+ *  \brief The fused measurement loop behind describeContour().
+ */
+
+/*!	\fn describeContour(const cv::Point* pts, size_t n, contour_descriptor& out)
+ *	\brief Measure a closed contour's area, perimeter, bounding box and moments in one pass over its points.
+ *
+ *	The point list is treated as a closed polygon, as by cv::findContours. A contour with no points
+ *	gets an empty descriptor, and one that encloses no area gets zero moments (as with cv::moments).
+ */
+void describeContour(const cv::Point* pts, size_t n, contour_descriptor& out) {
+	out = contour_descriptor();
+	if(n == 0) {
+		return;
+	}
+
+	int minX = pts[0].x;
+	int maxX = pts[0].x;
+	int minY = pts[0].y;
+	int maxY = pts[0].y;
+	double perimeter = 0;
+
+	/* Green's theorem sums over each edge (prev -> cur), as in OpenCV's contourMoments */
+	double a00 = 0, a10 = 0, a01 = 0, a20 = 0, a11 = 0, a02 = 0;
+	double xp = pts[n-1].x;
+	double yp = pts[n-1].y;
+
+	for(size_t i=0;i<n;i++) {
+		const int xi = pts[i].x;
+		const int yi = pts[i].y;
+		minX = std::min(minX, xi);
+		maxX = std::max(maxX, xi);
+		minY = std::min(minY, yi);
+		maxY = std::max(maxY, yi);
+
+		const double x = xi;
+		const double y = yi;
+		const double dx = x - xp;
+		const double dy = y - yp;
+		perimeter += std::sqrt((dx * dx) + (dy * dy));
+
+		const double dxy = (xp * y) - (x * yp);
+		const double sx = xp + x;
+		const double sy = yp + y;
+
+		a00 += dxy;
+		a10 += dxy * sx;
+		a01 += dxy * sy;
+		a20 += dxy * ((xp * sx) + (x * x));
+		a11 += dxy * ((xp * (sy + yp)) + (x * (sy + y)));
+		a02 += dxy * ((yp * sy) + (y * y));
+
+		xp = x;
+		yp = y;
+	}
+
+	out.area = std::fabs(a00 * 0.5);
+	out.perimeter = perimeter;
+	out.bounds = cv::Rect(minX, minY, (maxX - minX) + 1, (maxY - minY) + 1);
+
+	if(std::fabs(a00) > FLT_EPSILON) {
+		/* Clockwise contours sum to negative values; flip them so the moments don't depend on orientation */
+		const double s = (a00 > 0) ? 1.0 : -1.0;
+		out.moments = secondOrderMoments(s * a00 / 2, s * a10 / 6, s * a01 / 6, s * a20 / 12, s * a11 / 24, s * a02 / 12);
+	}
+}
+
+void describeContour(const cv::Mat& contour, contour_descriptor& out) {
+	CV_Assert(contour.empty() || ((contour.type() == CV_32SC2) && contour.isContinuous()));
+	describeContour(contour.empty() ? NULL : contour.ptr<cv::Point>(), contour.total(), out);
+}
+
+void describeContour(const std::vector<cv::Point>& contour, contour_descriptor& out) {
+	describeContour(contour.data(), contour.size(), out);
+}
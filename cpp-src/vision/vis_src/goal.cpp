@@ -1,5 +1,8 @@
 #include "visproc_interface.h"
 #include "visproc_common.h"
+#include "target_pipeline.h"
+#include "multi_target.h"
+#include "image_profile.h"
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/imgcodecs.hpp"
@@ -8,6 +11,7 @@
 #include <algorithm>
 #include <utility>
 #include <iostream>
+#include <climits>
 
 /*! \file goal.cpp
  *  \brief Contains goal processing functions (for 2016)
@@ -15,15 +19,24 @@
 
 const cv::Size goalSz(20.0, 12.0); // width, height -- TODO: Make sure this is correct!
 const double goalAS = goalSz.width / goalSz.height;
+const double goalTapeWidth = 2.0; // inches
+const double goalProfileDepth = 1.0 - (goalTapeWidth / goalSz.height); // height of the U's sides above its bottom, relative to the goal height
 
 typedef std::pair<double, double> distancePair;
 typedef std::pair<double, double> anglePair;
 
 // get horizontal angles to goal sides: left then right
-anglePair getAnglesToGoalSides(scoredContour contour, cv::Size frameSize) {
+anglePair getAnglesToGoalSides(const contour_record& contour, cv::Size frameSize) {
 	anglePair ret;
-	cv::Rect boundingBox = cv::boundingRect(contour.second);
+	const cv::Rect& boundingBox = contour.bounds;
 	cv::Point bl = cv::Point(boundingBox.x, boundingBox.y+boundingBox.height); // bottom left corner
+
+	if(visproc_camera.calibrated()) {
+		visproc_camera.setResolution(frameSize);
+		ret.first = visproc_camera.columnAngle(boundingBox.x);
+		ret.second = visproc_camera.columnAngle(boundingBox.br().x);
+		return ret;
+	}
 	
 	ret.first = ((2*(boundingBox.x-(frameSize.width/2))) / frameSize.width) * fovHoriz;
 	ret.second = ((2*(boundingBox.br().x - (frameSize.width/2))) / frameSize.width) * fovHoriz;
@@ -32,13 +45,17 @@ anglePair getAnglesToGoalSides(scoredContour contour, cv::Size frameSize) {
 }
 
 // get vertical distances to goal bottom and top (in order)
-distancePair getDistancesToGoalSides(scoredContour contour, cv::Size frameSize) {
+distancePair getDistancesToGoalSides(const contour_record& contour, cv::Size frameSize) {
 	distancePair ret;
-	cv::Rect boundingBox = cv::boundingRect(contour.second);
+	const cv::Rect& boundingBox = contour.bounds;
 	cv::Point bl = cv::Point(boundingBox.x, boundingBox.y+boundingBox.height); // bottom left corner
 	
 	
 	double theta = (boundingBox.height / frameSize.height) * fovVert;
+	if(visproc_camera.calibrated()) {
+		visproc_camera.setResolution(frameSize);
+		theta = visproc_camera.rowAngle(boundingBox.br().y) - visproc_camera.rowAngle(boundingBox.y);
+	}
 	
 	ret.first = (goalSz.height / tan(theta));
 	ret.second = (goalSz.height / sin(theta));
@@ -75,157 +92,368 @@ TODO:
 
 int goal_hueThres[2] = {70, 100};	//!< Hue thresholds (min, max) for detecting goal retroreflective tape.
 int goal_valThres[2] = {128, 255};	//!< Value thesholds for detecting goals.
+hsv_color_lut goal_colorLUT;		//!< Color table for goal thresholds, used with THRES_LUT.
 
-/*!	\fn goal_preprocess_pipeline(cv::Mat input, bool suppress_output, bool live_output)
- *	\brief Filter and edge-detect an image, searching for goals.
- *
- *	\param input Input frame.
- *	\param suppress_output If false, then debugging data is written to stdout.
- *	\param live_output If true, then intermediate pipeline image streams are output to GUI windows.
+/*! \struct goal_target
+ *  \brief target_pipeline.h policy for the goal retroreflective tape.
  */
-cv::Mat goal_preprocess_pipeline(cv::Mat input, bool suppress_output, bool live_output) {
-        cv::Mat tmp(input.size(), input.type());
+struct goal_target {
+	static const int morphOp = cv::MORPH_ERODE;		//!< Erode away smaller hits.
+	static const int morphSize = 5;
+	static const int blurSize = 3;
+	static const int hsvBlurSize = 5;
+	static constexpr double hsvBlurSigma = 2.5;
+	static const int hsvBlurBorder = cv::BORDER_REPLICATE;
+	static constexpr double minArea = 1000;			//!< Minimum contour area (in full-resolution pixels) for a goal candidate.
+
+	static hsv_range range() {
+		return hsv_range(goal_hueThres[0], goal_hueThres[1], 0, 255, goal_valThres[0], goal_valThres[1]);
+	}
+	static hsv_color_lut& colorLUT() { return goal_colorLUT; }
+	static score_cascade& cascade() { return goal_cascade; }
 
-        cv::cvtColor(input, tmp, CV_BGR2HSV);
+	static double test(int t, const candidate_geometry& c, bool suppress_output);
+};
 
-        /* Make things easier for the HV filter */
-        //cv::blur(tmp, tmp, cv::Size(5,5));
-        cv::GaussianBlur(tmp, tmp, cv::Size(5,5), 2.5, 2.5, cv::BORDER_REPLICATE);
-		drawOut("stage1", tmp, live_output);
+/* Score one candidate on one cascade test; shared by the contour and blob engines. */
+double goal_target::test(int t, const candidate_geometry& c, bool suppress_output) {
+        switch(t) {
+        case GOAL_TEST_COVERAGE:
+        {
+                /*! Coverage Area Test
+                 * Compare particle area vs. Bounding Rectangle area.
+                 * Score decreases linearly as coverage area tends away from the ideal (80 / 240 = 1/3). */
+                const double cvarea_target = (80.0 / (goalSz.width * goalSz.height)); //(80.0/240.0);
+                double coverage_area = c.area / c.bounds.area();
+                double cvarea_score = scoreDistanceFromTarget(cvarea_target, coverage_area);
 
-        /* Filter on color/brightness */
-        cv::Mat mask(input.size(), CV_8U);
-        cv::inRange(tmp,
-					cv::Scalar((unsigned char)goal_hueThres[0],0,(unsigned char)goal_valThres[0]),
-					cv::Scalar((unsigned char)goal_hueThres[1],255,(unsigned char)goal_valThres[1]),
-					mask);
-		drawOut("stage2", mask, live_output);
+		if(!suppress_output) {
+		    std::cout << "CVArea: "  <<  coverage_area << std::endl;
+		    std::cout << "CVArea Score: "  <<  cvarea_score << std::endl;
+		}
+                return cvarea_score;
+        }
+        case GOAL_TEST_ASPECT:
+        {
+                /*! Aspect Ratio Test
+                 * Computes aspect ratio of detected objects.
+                 */
+                double tmp = c.bounds.width;
+                double aspect_ratio = tmp / c.bounds.height;
+                double ar_score = scoreDistanceFromTarget(goalAS, aspect_ratio);
+
+		if(!suppress_output) {
+		    std::cout << "AsRatio: " << aspect_ratio << std::endl;
+		    std::cout << "AsRatio Score: " << ar_score << std::endl;
+		}
+                return ar_score;
+        }
+        case GOAL_TEST_PROFILE:
+        {
+                /*! Height Profile Test
+                 * Looks for the U in the mask's column heights: high at either side, the tape's width in between.
+                 * Score decreases linearly as the depth of the U tends away from the ideal. Candidates with no mask
+                 * to look at (custom preprocessing, ENGINE_RLE) pass. */
+                if(c.mask == NULL) {
+                        return 100;
+                }
 
-        /* Erode away smaller hits */
-        cv::erode(mask, mask, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5,5)));
-		drawOut("stage3", mask, live_output);
+                static thread_local height_profile_work work;
+                static thread_local std::vector<unsigned int> profile;
+                particleHeightProfile(*c.mask, c.bounds - c.maskOffset, profile, work);
+                goalProfileData data = analyzeHeightProfile(profile, c.bounds.height, work);
 
-        /* Blur for edge detection */
-        cv::Mat edgedet;
-        cv::blur(mask, edgedet, cv::Size(3,3));
-		drawOut("stage4", edgedet, live_output);
+                double depth = 0;
+                if(data.found) {
+                        depth = (std::min(data.averageHighState1, data.averageHighState2) - data.averageLowState) / c.bounds.height;
+                }
+                double profile_score = data.found ? scoreDistanceFromTarget(goalProfileDepth, depth) : 0;
 
-        cv::Canny(edgedet, edgedet, cannyThresMin, cannyThresMin+cannyThresSize);
-		drawOut("stage5", edgedet, live_output);        
+		if(!suppress_output) {
+		    std::cout << "Profile depth: " << depth << (data.found ? "" : " (no U found)") << std::endl;
+		    std::cout << "Profile Score: " << profile_score << std::endl;
+		}
+                return profile_score;
+        }
+        case GOAL_TEST_MOMENT:
+        {
+                /*! Image Moment Test
+                 * Computes image moments and compares it to known values.
+                 */
+                double moment_score = scoreDistanceFromTarget(0.28, c.moments().nu02);
 
-		return edgedet;
+		if(!suppress_output) {
+		    std::cout << "nu-02: " << c.moments().nu02 << std::endl;
+		    std::cout << "Moment Score: " << moment_score << std::endl;
+		}
+                return moment_score;
+        }
+        case GOAL_TEST_ANGLE:
+        {
+                /*! Image Orientation Test
+                 * Computes angles off-axis or contours.
+                 */
+                // theta = (1/2)atan2(mu11, mu20-mu02) radians
+                // theta ranges from -90 degrees to +90 degrees.
+                const cv::Moments& m = c.moments();
+                double theta = (atan2(m.mu11,m.mu20-m.mu02) * 90) / pi;
+                double angle_score = (90 - fabs(theta))+10;
+
+		if(!suppress_output) {
+		    std::cout << "Orientation: " << theta << std::endl;
+		    std::cout << "Angle Score: " << angle_score << std::endl;
+		}
+                return angle_score;
+        }
+        default:
+                return 0;
+        }
 }
 
-/*!	\fn goal_pipeline(cv::Mat input, bool suppress_output, bool live_output)
- *	\brief Score and retrieve the best seeming goal from a preprocessed image.
+/*!	\fn goal_target_class()
+ *	\brief The goal target, for registering with a multi_target_detector.
+ */
+target_class goal_target_class() {
+	return make_target_class<goal_target>("goal");
+}
+
+/*!	\fn goal_preprocess_pipeline(cv::Mat frame, visproc_context& ctx, bool suppress_output, bool live_output)
+ *	\brief Filter and edge-detect an image, searching for goals.
  *
- *	\param input Input frame.
+ *	If ctx.roiTracking is set, only the window ctx.roi around the previous detection is processed,
+ *	and the returned Mat covers just that window.
+ *	\param frame Input frame.
+ *	\param ctx Context holding the intermediate buffers; the returned Mat is ctx.edges
+ *	(or, with ENGINE_BLOBS, the eroded binary mask in ctx.blurred). With ENGINE_RLE, the eroded mask
+ *	stays run-length encoded in ctx.rleMorph, where goal_pipeline picks it up, and the returned Mat is empty.
+ *	If ctx.preprocess is set, that pipeline is run instead of the built-in chain, and its output is returned.
+ *	If ctx.skipStaticFrames is set and ctx.changes finds the frame unchanged, nothing is processed: ctx.frameReused
+ *	is set, the returned Mat is left over from an earlier frame, and goal_pipeline returns the previous result.
  *	\param suppress_output If false, then debugging data is written to stdout.
  *	\param live_output If true, then intermediate pipeline image streams are output to GUI windows.
  */
-scoredContour goal_pipeline(cv::Mat input, bool suppress_output, bool window_output) {
-        std::vector< std::vector<cv::Point> > contours;
+cv::Mat& goal_preprocess_pipeline(cv::Mat frame, visproc_context& ctx, bool suppress_output, bool live_output) {
+        /* Nothing has moved since the last processed frame, so goal_pipeline can hand back its result as-is */
+        ctx.frameReused = ctx.skipStaticFrames && !ctx.changes.changed(frame);
+        if(ctx.frameReused) {
+            if(!suppress_output) { std::cout << "Frame unchanged; reusing the previous result." << std::endl; }
+            return ctx.edges;
+        }
 
-        cv::Mat contourOut = input.clone();
+        /* Only process the window around the last detection, if we're tracking one */
+        cv::Rect window = ctx.beginFrame(frame.size());
+        if(!suppress_output) {
+            std::cout << "Preprocessing " << window.width << "x" << window.height << " at (" << window.x << ", " << window.y << ")" << std::endl;
+        }
 
-        cv::findContours(contourOut, contours, CV_RETR_LIST, CV_CHAIN_APPROX_NONE);
-        std::vector<scoredContour> finalscores;
+        target_update_lut<goal_target>();
+        return target_preprocess_window<goal_target>(frame(window), ctx, live_output);
+}
 
-        if(!suppress_output) { std::cout << "Found " << contours.size() << " contours." << std::endl; }
+/*!	\fn goal_preprocess_pipeline(cv::Mat input, bool suppress_output, bool live_output)
+ *	\brief Filter and edge-detect an image, searching for goals.
+ *
+ *	Allocates a fresh set of buffers on every call; long-running callers should keep a visproc_context instead.
+ *	\param input Input frame.
+ *	\param suppress_output If false, then debugging data is written to stdout.
+ *	\param live_output If true, then intermediate pipeline image streams are output to GUI windows.
+ */
+cv::Mat goal_preprocess_pipeline(cv::Mat input, bool suppress_output, bool live_output) {
+		visproc_context ctx;
+		cv::Mat& out = goal_preprocess_pipeline(input, ctx, suppress_output, live_output);
 
-		if(window_output) {
-			cv::Mat conOut = cv::Mat::zeros(input.size(), CV_8UC3);
-			for(int i=0;i<contours.size();i++) {
-				double area = cv::contourArea(contours[i]);
-				cv::Scalar col(rand()&180, rand()&255, rand()&255);
-				cv::drawContours(conOut, contours, i, col, CV_FILLED, 8);
-			}
-			drawOut("contours", conOut, window_output);
+		/* The context is about to go away, so hand back a decoded mask */
+		if(visproc_detectEngine == ENGINE_RLE) {
+			ctx.rleMorph.toMat(out);
 		}
+		return out;
+}
+/* Pick the best entry of ctx.scores (leaving only it there), or a score of 0 if there are none. */
+static scoredIndex goal_top_score(visproc_context& ctx) {
+       if(selectTopScores(ctx.scores, 1) > 0) {
+		return ctx.scores[0];
+	} else {
+		return std::make_pair(0.0, 0);
+	}
+}
 
-        unsigned int ctr = 0;
-        for(std::vector< std::vector<cv::Point> >::iterator i = contours.begin();
-            i != contours.end(); ++i) {
-                double area = cv::contourArea(*i);
-                double perimeter = cv::arcLength(*i, true);
-                cv::Rect bounds = cv::boundingRect(*i);
-
-                const double cvarea_target = (80.0 / (goalSz.width * goalSz.height)); //(80.0/240.0);
-                const double area_threshold = 1000;
+/* Find and score candidates in a preprocessed frame or window.
+ * Returns the best score and its index (see target_score()), or a score of 0 if nothing qualified. */
+static scoredIndex goal_score(cv::Mat input, cv::Point offset, visproc_context& ctx, bool suppress_output, bool window_output) {
+        target_score<goal_target>(input, offset, ctx, suppress_output, window_output, 1);
+        return goal_top_score(ctx);
+}
 
-                /*! Area Thresholding Test
-                 * Only accept contours of a certain total size.
-                 */
+/* Record the winning contour (or blob outline) in ctx.detections, and copy it out to ctx.best.
+ * top must come from the last goal_score() call. */
+static void goal_set_best(visproc_context& ctx, const scoredIndex& top) {
+	if(ctx.scores.empty()) {
+		ctx.detections.clear();
+		ctx.best.first = 0.0;
+		ctx.best.second.clear();
+		return;
+	}
 
-                if(area < area_threshold) {
-                    continue;
-                }
+	ctx.detections.assign(1, target_record(ctx, top));
+	ctx.best.first = top.first;
+	ctx.arena.copyTo(ctx.detections[0], ctx.best.second);
+}
 
-		if(!suppress_output) {
-			std::cout << std::endl;
-			std::cout << "Contour " << ctr << ": " << std::endl;
-			ctr++;
-			std::cout << "Area: "  << area << std::endl;
-			std::cout << "Perimeter: " << perimeter << std::endl;
-		}
+/*!	\fn goal_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output, bool window_output)
+ *	\brief Score and retrieve the best seeming goal from a preprocessed image.
+ *
+ *	Contours are reported in full-frame coordinates even when only ctx.roi was processed.
+ *	With ENGINE_RLE, the mask is read from ctx.rleMorph and input is ignored.
+ *	If goal_preprocess_pipeline skipped the frame as unchanged (ctx.frameReused), the last result is returned
+ *	again; either way ctx.resultTicks is set to the current time.
+ *	\param input Preprocessed frame (or window) from goal_preprocess_pipeline.
+ *	\param ctx Context holding the contour stores; the returned reference is ctx.best (also in ctx.detections).
+ *	\param suppress_output If false, then debugging data is written to stdout.
+ *	\param live_output If true, then intermediate pipeline image streams are output to GUI windows.
+ */
+const scoredContour& goal_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output, bool window_output) {
+	ctx.resultTicks = cv::getTickCount();
+	if(ctx.frameReused) {
+		return ctx.best;
+	}
 
-                /*! Coverage Area Test
-                 * Compare particle area vs. Bounding Rectangle area.
-                 * score = 1 / abs((1/3)- (particle_area / boundrect_area))
-                 * Score decreases linearly as coverage area tends away from 1/3. */
-                double cvarea_score = 0;
+	ctx.clearCandidates();
+	goal_set_best(ctx, goal_score(input, ctx.roi.tl(), ctx, suppress_output, window_output));
+	ctx.endFrame(ctx.detections);
 
-                double coverage_area = area / bounds.area();
-                cvarea_score = scoreDistanceFromTarget(cvarea_target, coverage_area);
+	return ctx.best;
+}
 
-                /*! Aspect Ratio Test
-                 * Computes aspect ratio of detected objects.
-                 */
+/*!	\fn goal_pipeline_pyramid(cv::Mat frame, visproc_context& ctx, bool suppress_output)
+ *	\brief Coarse-to-fine goal search: find candidates at reduced resolution, then score them at full resolution.
+ *
+ *	The frame is downscaled by ctx.coarseScale and color-thresholded. Each blob that would pass the area
+ *	test at full resolution becomes a candidate window (up to ctx.coarseMaxCandidates of the largest),
+ *	expanded by ctx.roiMinMargin pixels. The full preprocessing and contour scoring chain is then run
+ *	on just those windows of the full-resolution frame, so the returned contour (and any distance computed
+ *	from it) has full-resolution accuracy.
+ *
+ *	A coarseScale of 0 or >= 1 disables the coarse pass and searches the full frame.
+ *	ROI tracking doesn't narrow the coarse pass, but ctx.frameSize and the tracking state are kept up to date, and
+ *	ctx.roi is left covering the whole frame.
+ *	Unchanged frames are skipped with ctx.skipStaticFrames, as in goal_preprocess_pipeline.
+ *	\param frame Input frame.
+ *	\param ctx Context holding the intermediate buffers; the returned reference is ctx.best.
+ *	\param suppress_output If false, then debugging data is written to stdout.
+ */
+const scoredContour& goal_pipeline_pyramid(cv::Mat frame, visproc_context& ctx, bool suppress_output) {
+	if((ctx.coarseScale <= 0) || (ctx.coarseScale >= 1)) {
+		return goal_pipeline(goal_preprocess_pipeline(frame, ctx, suppress_output), ctx, suppress_output);
+	}
 
-                double tmp = bounds.width;
-                double aspect_ratio = tmp / bounds.height;
-                double ar_score = scoreDistanceFromTarget(goalAS, aspect_ratio);
+	ctx.resultTicks = cv::getTickCount();
+	ctx.frameReused = ctx.skipStaticFrames && !ctx.changes.changed(frame);
+	if(ctx.frameReused) {
+		return ctx.best;
+	}
 
-                /*! Image Moment Test
-                 * Computes image moments and compares it to known values.
-                 */
+	/* The coarse pass always covers the whole frame; beginFrame() still tracks frame size changes, so
+	 * ctx stays consistent when callers switch between this and the ROI-tracking pipeline */
+	ctx.beginFrame(frame.size());
+	const double scale = ctx.coarseScale;
+	cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+	ctx.roi = frameRect;
+
+	/* The coarse pass and every window are classified with the same color table */
+	target_update_lut<goal_target>();
+
+	/* Coarse pass: threshold only, no morphology or edge detection */
+	cv::resize(frame, ctx.coarse, cv::Size(), scale, scale, cv::INTER_AREA);
+	target_threshold<goal_target>(ctx.coarse, ctx.hsv, ctx.coarseMask, false);
+	ctx.coarseArena.clear();
+	ctx.coarseArena.extract(ctx.coarseMask, cv::Point(), 1, true);
+
+	ctx.windows.clear();
+	for(size_t i=0;i<ctx.coarseArena.size();i++) {
+		cv::Rect c = cv::boundingRect(ctx.coarseArena.contour(i));
+
+		/* The bounding box area bounds the contour area from above; halve the threshold to allow for
+		 * blobs that shrink when downsampled. */
+		if((c.area() / (scale * scale)) < (goal_target::minArea / 2)) {
+			continue;
+		}
 
-                cv::Moments m = cv::moments(*i);
-                double moment_score = scoreDistanceFromTarget(0.28, m.nu02);
+		cv::Rect w((int)(c.x / scale) - ctx.roiMinMargin, (int)(c.y / scale) - ctx.roiMinMargin,
+			(int)(c.width / scale) + (2*ctx.roiMinMargin), (int)(c.height / scale) + (2*ctx.roiMinMargin));
+		ctx.windows.push_back(w & frameRect);
+	}
 
-                /*! Image Orientation Test
-                 * Computes angles off-axis or contours.
-                 */
-                // theta = (1/2)atan2(mu11, mu20-mu02) radians
-                // theta ranges from -90 degrees to +90 degrees.
-                double theta = (atan2(m.mu11,m.mu20-m.mu02) * 90) / pi;
-                double angle_score = (90 - fabs(theta))+10;
+	if(ctx.windows.size() > ctx.coarseMaxCandidates) {
+		std::nth_element(ctx.windows.begin(), ctx.windows.begin() + ctx.coarseMaxCandidates, ctx.windows.end(),
+			[](const cv::Rect& a, const cv::Rect& b) { return a.area() > b.area(); });
+		ctx.windows.resize(ctx.coarseMaxCandidates);
+	}
 
-		if(!suppress_output) {
-		    std::cout << "nu-02: " << m.nu02 << std::endl;
-		    std::cout << "CVArea: "  <<  coverage_area << std::endl;
-		    std::cout << "AsRatio: " << aspect_ratio << std::endl;
-		    std::cout << "Orientation: " << theta << std::endl;
+	/* Merge overlapping windows so that no pixel is processed twice. A merged window can grow into
+	 * one already checked, so start over after every merge until a whole pass merges nothing. */
+	bool merged = true;
+	while(merged) {
+		merged = false;
+		for(size_t i=0;(i < ctx.windows.size()) && !merged;i++) {
+			for(size_t j=i+1;j<ctx.windows.size();j++) {
+				if((ctx.windows[i] & ctx.windows[j]).area() > 0) {
+					ctx.windows[i] |= ctx.windows[j];
+					ctx.windows.erase(ctx.windows.begin() + j);
+					merged = true;
+					break;
+				}
+			}
 		}
+	}
 
-                double total_score = (moment_score + cvarea_score + ar_score + angle_score) / 4;
+	if(!suppress_output) { std::cout << "Coarse pass found " << ctx.windows.size() << " candidate windows." << std::endl; }
 
-		if(!suppress_output) {
-		    std::cout << "CVArea Score: "  <<  cvarea_score << std::endl;
-		    std::cout << "AsRatio Score: " << ar_score << std::endl;
-		    std::cout << "Moment Score: " << moment_score << std::endl;
-		    std::cout << "Angle Score: " << angle_score << std::endl;
-		    std::cout << "Total Score: " << total_score << std::endl;
+	/* Fine pass: full-resolution chain on each window; every window's contours go into the same arena */
+	ctx.clearCandidates();
+	ctx.detections.clear();
+	ctx.best.first = 0.0;
+	ctx.best.second.clear();
+	for(size_t i=0;i<ctx.windows.size();i++) {
+		ctx.roi = ctx.windows[i];
+		cv::Mat& processed = target_preprocess_window<goal_target>(frame(ctx.roi), ctx, false);
+
+		scoredIndex top = goal_score(processed, ctx.roi.tl(), ctx, suppress_output, false);
+		if(top.first > ctx.best.first) {
+			goal_set_best(ctx, top);
 		}
+	}
+	ctx.roi = frameRect;
 
-                finalscores.push_back(std::make_pair(total_score, std::move(*i)));
-        }
+	ctx.endFrame(ctx.detections);
 
-       if(finalscores.size() > 0) {
-		std::sort(finalscores.begin(), finalscores.end(), &scoresort);
+	return ctx.best;
+}
 
-		return finalscores.back();
-	} else {
-		return std::make_pair(0.0, std::vector<cv::Point>());	
+/*!	\fn goal_pipeline(cv::Mat input, bool suppress_output, bool window_output)
+ *	\brief Score and retrieve the best seeming goal from a preprocessed image.
+ *
+ *	Allocates a fresh set of buffers on every call; long-running callers should keep a visproc_context instead.
+ *	\param input Input frame.
+ *	\param suppress_output If false, then debugging data is written to stdout.
+ *	\param live_output If true, then intermediate pipeline image streams are output to GUI windows.
+ */
+scoredContour goal_pipeline(cv::Mat input, bool suppress_output, bool window_output) {
+		visproc_context ctx;
+		if(visproc_detectEngine == ENGINE_RLE) {
+			ctx.rleMorph.fromMat(input);
+		}
+		return goal_pipeline(input, ctx, suppress_output, window_output);
+}
+
+/*!	\fn goal_pipeline_full(cv::Mat src)
+ *	\brief Run the whole goal search on a frame.
+ *	\return Distance to the best goal, or -1 if none was found.
+ */
+double goal_pipeline_full(cv::Mat src) {
+	visproc_context ctx;
+	goal_pipeline(goal_preprocess_pipeline(src, ctx), ctx);
+	if( ctx.detections.size() > 0 ) {
+		return getDistance(ctx.detections[0].bounds.size(), src.size());
 	}
+	return -1;
 }
@@ -0,0 +1,268 @@
+#include "hsv_threshold.h"
+#include "opencv2/core.hpp"
+#include <cmath>
+
+/*! \file hsv_threshold.cpp
+ *  \brief Single-pass BGR -> binary mask color thresholding.
+ */
+
+int visproc_thresholdMode = THRES_LEGACY;
+
+/* Fixed-point division tables, built the same way as OpenCV's 8-bit RGB2HSV_b. */
+const int hsv_shift = 12;
+
+struct hsv_div_tables {
+	int sdiv[256];
+	int hdiv[256];
+
+	hsv_div_tables() {
+		sdiv[0] = hdiv[0] = 0;
+		for(int i=1;i<256;i++) {
+			sdiv[i] = (int)std::lrint((255 << hsv_shift) / (1.0*i));
+			hdiv[i] = (int)std::lrint((180 << hsv_shift) / (6.0*i));
+		}
+	}
+};
+
+static const hsv_div_tables hsvTables;
+
+static inline void convertPixel(int b, int g, int r, int& h, int& s, int& v) {
+	int vmin = b;
+	v = b;
+	if(g > v) v = g;
+	if(r > v) v = r;
+	if(g < vmin) vmin = g;
+	if(r < vmin) vmin = r;
+
+	int diff = v - vmin;
+	int vr = (v == r) ? -1 : 0;
+	int vg = (v == g) ? -1 : 0;
+
+	s = (diff * hsvTables.sdiv[v] + (1 << (hsv_shift-1))) >> hsv_shift;
+	h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2*diff)) + ((~vg) & (r - g + 4*diff))));
+	h = (h * hsvTables.hdiv[diff] + (1 << (hsv_shift-1))) >> hsv_shift;
+	h += (h < 0) ? 180 : 0;
+}
+
+/*! \fn bgrToHSV8U(const unsigned char* bgr, unsigned char* hsv)
+ *  \brief Convert a single BGR pixel to 8-bit HSV. Matches cv::cvtColor(CV_BGR2HSV) exactly.
+ */
+void bgrToHSV8U(const unsigned char* bgr, unsigned char* hsv) {
+	int h, s, v;
+	convertPixel(bgr[0], bgr[1], bgr[2], h, s, v);
+	hsv[0] = h;
+	hsv[1] = s;
+	hsv[2] = v;
+}
+
+static void thresholdRowScalar(const unsigned char* in, unsigned char* out, int width, const hsv_range& range) {
+	for(int x=0;x<width;x++, in+=3) {
+		int h, s, v;
+		convertPixel(in[0], in[1], in[2], h, s, v);
+
+		bool pass = (h >= range.min[0]) && (h <= range.max[0]) &&
+					(s >= range.min[1]) && (s <= range.max[1]) &&
+					(v >= range.min[2]) && (v <= range.max[2]);
+		out[x] = pass ? 255 : 0;
+	}
+}
+
+/* 4-wide vector types. These lower to SSE on x86-64 and NEON on ARM (with -mfpu=neon). */
+typedef float v4f __attribute__((vector_size(16)));
+typedef int v4i __attribute__((vector_size(16)));
+
+static inline v4f vselect(v4i m, v4f a, v4f b) {
+	return (v4f)((m & (v4i)a) | (~m & (v4i)b));
+}
+
+static inline v4f vmax(v4f a, v4f b) { return vselect(a > b, a, b); }
+static inline v4f vmin(v4f a, v4f b) { return vselect(a < b, a, b); }
+
+/* Convert 4 BGR pixels to unrounded H, S and V. */
+static inline void convertPixels4(const unsigned char* in, v4f& h, v4f& s, v4f& v) {
+	const v4f zero = {0, 0, 0, 0};
+	const v4f one = {1, 1, 1, 1};
+	const v4f two = {2, 2, 2, 2};
+	const v4f four = {4, 4, 4, 4};
+	const v4f k30 = {30, 30, 30, 30};
+	const v4f k180 = {180, 180, 180, 180};
+	const v4f k255 = {255, 255, 255, 255};
+	const v4f wrap = {-0.5f, -0.5f, -0.5f, -0.5f};
+
+	v4f b = {(float)in[0], (float)in[3], (float)in[6], (float)in[9]};
+	v4f g = {(float)in[1], (float)in[4], (float)in[7], (float)in[10]};
+	v4f r = {(float)in[2], (float)in[5], (float)in[8], (float)in[11]};
+
+	v = vmax(b, vmax(g, r));
+	v4f diff = v - vmin(b, vmin(g, r));
+
+	/* Avoid 0/0 on black and gray pixels; their numerators are zero anyway. */
+	v4f vDen = v + (v4f)((v4i)(v == zero) & (v4i)one);
+	v4f diffDen = diff + (v4f)((v4i)(diff == zero) & (v4i)one);
+
+	s = (diff * k255) / vDen;
+
+	v4f hNum = vselect(v == r, g - b,
+				vselect(v == g, (b - r) + (two * diff), (r - g) + (four * diff)));
+	h = (hNum * k30) / diffDen;
+	h = h + (v4f)((v4i)(h < wrap) & (v4i)k180);
+}
+
+/*
+ * Rather than rounding H and S to integers, compare the unrounded values against bounds
+ * offset by one half: round(x) >= lo  <=>  x >= lo - 0.5, and round(x) <= hi  <=>  x < hi + 0.5.
+ */
+struct v4_bounds {
+	v4f lo[3];
+	v4f hi[3];
+
+	v4_bounds() {};
+	v4_bounds(const hsv_range& range) {
+		for(int c=0;c<3;c++) {
+			float l = range.min[c] - 0.5f;
+			float u = range.max[c] + 0.5f;
+			v4f vl = {l, l, l, l};
+			v4f vu = {u, u, u, u};
+			lo[c] = vl;
+			hi[c] = vu;
+		}
+	}
+
+	v4i contains(v4f h, v4f s, v4f v) const {
+		return (h >= lo[0]) & (h < hi[0]) &
+			   (s >= lo[1]) & (s < hi[1]) &
+			   (v >= lo[2]) & (v < hi[2]);
+	}
+};
+
+static void thresholdRowSIMD(const unsigned char* in, unsigned char* out, int width, const hsv_range& range) {
+	const v4_bounds bounds(range);
+
+	int x = 0;
+	for(;x+4<=width;x+=4, in+=12) {
+		v4f h, s, v;
+		convertPixels4(in, h, s, v);
+
+		v4i pass = bounds.contains(h, s, v);
+
+		out[x] = (unsigned char)pass[0];
+		out[x+1] = (unsigned char)pass[1];
+		out[x+2] = (unsigned char)pass[2];
+		out[x+3] = (unsigned char)pass[3];
+	}
+
+	if(x < width) {
+		thresholdRowScalar(in, out+x, width-x, range);
+	}
+}
+
+/*!	\fn fusedHSVThreshold(const cv::Mat& bgr, cv::Mat& mask, const hsv_range& range, int mode)
+ *	\brief Threshold a BGR frame on HSV bounds in a single pass, without an intermediate HSV image.
+ *
+ *	\param bgr Input frame (CV_8UC3, BGR order). May be a submatrix.
+ *	\param mask Output mask (CV_8U); pixels within range are set to 255, all others to 0.
+ *	\param range HSV bounds to accept.
+ *	\param mode THRES_FUSED or THRES_FUSED_SIMD. See hsv_threshold.h for tolerances.
+ */
+void fusedHSVThreshold(const cv::Mat& bgr, cv::Mat& mask, const hsv_range& range, int mode) {
+	CV_Assert(bgr.type() == CV_8UC3);
+	mask.create(bgr.size(), CV_8U);
+
+	for(int y=0;y<bgr.rows;y++) {
+		const unsigned char* in = bgr.ptr<unsigned char>(y);
+		unsigned char* out = mask.ptr<unsigned char>(y);
+
+		if(mode == THRES_FUSED_SIMD) {
+			thresholdRowSIMD(in, out, bgr.cols, range);
+		} else {
+			thresholdRowScalar(in, out, bgr.cols, range);
+		}
+	}
+}
+
+/* Classify one row against several ranges, converting each pixel only once. */
+static void thresholdRowMulti(const unsigned char* in, unsigned char** out, int width, const hsv_range* ranges, int n, int mode) {
+	int x = 0;
+
+	if(mode == THRES_FUSED_SIMD) {
+		v4_bounds bounds[MULTI_THRES_MAX];
+		for(int i=0;i<n;i++) {
+			bounds[i] = v4_bounds(ranges[i]);
+		}
+
+		for(;x+4<=width;x+=4, in+=12) {
+			v4f h, s, v;
+			convertPixels4(in, h, s, v);
+
+			for(int i=0;i<n;i++) {
+				v4i pass = bounds[i].contains(h, s, v);
+				out[i][x] = (unsigned char)pass[0];
+				out[i][x+1] = (unsigned char)pass[1];
+				out[i][x+2] = (unsigned char)pass[2];
+				out[i][x+3] = (unsigned char)pass[3];
+			}
+		}
+	}
+
+	for(;x<width;x++, in+=3) {
+		unsigned char hsv[3];
+		bgrToHSV8U(in, hsv);
+
+		for(int i=0;i<n;i++) {
+			out[i][x] = ranges[i].contains(hsv) ? 255 : 0;
+		}
+	}
+}
+
+/*!	\fn multiHSVThreshold(const cv::Mat& bgr, cv::Mat* masks, const hsv_range* ranges, int n, int mode)
+ *	\brief Threshold a BGR frame on several sets of HSV bounds at once.
+ *
+ *	Each pixel is converted to HSV once and tested against every range, so n masks cost
+ *	one conversion pass instead of n. Results are identical to n calls to fusedHSVThreshold().
+ *	\param bgr Input frame (CV_8UC3, BGR order). May be a submatrix.
+ *	\param masks n output masks (CV_8U); masks[i] is set to 255 where a pixel is within ranges[i].
+ *	\param ranges n HSV bounds to accept.
+ *	\param n Number of ranges, at most MULTI_THRES_MAX.
+ *	\param mode THRES_FUSED or THRES_FUSED_SIMD.
+ */
+void multiHSVThreshold(const cv::Mat& bgr, cv::Mat* masks, const hsv_range* ranges, int n, int mode) {
+	CV_Assert((bgr.type() == CV_8UC3) && (n <= MULTI_THRES_MAX));
+
+	unsigned char* out[MULTI_THRES_MAX];
+	for(int i=0;i<n;i++) {
+		masks[i].create(bgr.size(), CV_8U);
+	}
+
+	for(int y=0;y<bgr.rows;y++) {
+		for(int i=0;i<n;i++) {
+			out[i] = masks[i].ptr<unsigned char>(y);
+		}
+		thresholdRowMulti(bgr.ptr<unsigned char>(y), out, bgr.cols, ranges, n, mode);
+	}
+}
+
+/*!	\fn fusedHSVThreshold(const cv::Mat& bgr, rle_mask& mask, const hsv_range& range, int mode)
+ *	\brief Threshold a BGR frame on HSV bounds straight into a run-length encoded mask.
+ *
+ *	Each row is classified into a single row of scratch and encoded immediately, so no full-frame mask is written.
+ *	\param bgr Input frame (CV_8UC3, BGR order). May be a submatrix.
+ *	\param mask Output mask.
+ *	\param range HSV bounds to accept.
+ *	\param mode THRES_FUSED or THRES_FUSED_SIMD.
+ */
+void fusedHSVThreshold(const cv::Mat& bgr, rle_mask& mask, const hsv_range& range, int mode) {
+	CV_Assert(bgr.type() == CV_8UC3);
+	mask.reset(bgr.size());
+
+	unsigned char* out = mask.rowBuffer();
+	for(int y=0;y<bgr.rows;y++) {
+		const unsigned char* in = bgr.ptr<unsigned char>(y);
+
+		if(mode == THRES_FUSED_SIMD) {
+			thresholdRowSIMD(in, out, bgr.cols, range);
+		} else {
+			thresholdRowScalar(in, out, bgr.cols, range);
+		}
+		mask.appendRow(y, out);
+	}
+}
@@ -1,96 +1,143 @@
 #include "image_profile.h"
+#include "opencv2/core.hpp"
+#include <vector>
+#include <algorithm>
+
+/*! \file image_profile.cpp
+ *  \brief Height profile extraction and edge detection.
+ */
 
 /*!
- * \fn particleHeightProfile(std::vector<cv::Point> contour)
- * \brief Calculate 1-dimensional height profile of a given contour.
+ * \fn particleHeightProfile(const cv::Mat& mask, const cv::Rect& bounds, std::vector<unsigned int>& profile, height_profile_work& work)
+ * \brief Calculate 1-dimensional height profile of the mask inside a bounding box.
  *
- * (y = distance(lowestpoint(x), highestpoint(x)) for all columns x
+ * profile[x] = distance from the bottom of bounds to the highest set pixel in column x of the box (counting
+ * the bottom row as 1), or 0 if the column is empty. Pixels count as set above 127, so a lightly blurred
+ * mask can be used as-is.
+ * \param mask 8-bit single channel mask.
+ * \param bounds Box to profile, in mask coordinates; clipped to the mask.
  */
-std::vector<unsigned int> particleHeightProfile(std::vector<cv::Point> contour) {
-	cv::Rect bounds = cv::boundingRect(contour);
-	std::vector<unsigned int> distance(bounds.width, 0); // smallest distance from top of bounds to point in column of contour
-	
-	int bottomHeight = (bounds.y + bounds.height);
-
-	// find lowest / highest points per column in contour:
-	for(cv::Point i : contour) {
-		int col = i.x -  bounds.x;
-		int dist = abs(bottomHeight - i.y);
-		distance[col] = max(distance[col], dist);
+void particleHeightProfile(const cv::Mat& mask, const cv::Rect& bounds, std::vector<unsigned int>& profile, height_profile_work& work) {
+	cv::Rect box = bounds & cv::Rect(0, 0, mask.cols, mask.rows);
+	profile.assign(box.width, 0);
+	if(box.area() == 0) {
+		return;
+	}
+
+	CV_Assert(mask.type() == CV_8UC1);
+	CV_Assert(box.height <= 0xFFFF);
+
+	/* Each pixel's height above the bottom of the box, kept where the mask is set; the highest
+	 * per column is then one column reduction. Every step is a whole-image OpenCV kernel, which is
+	 * vectorized in the OpenCV build itself (our -Og build doesn't auto-vectorize loops of its own).
+	 * The buffers only ever grow: each call works in views of their corners, so candidates of varying
+	 * size don't reallocate them. rowHeights counts up from its bottom row, so its bottom left corner
+	 * holds the heights for any smaller box. */
+	if((work.rowHeights.rows < box.height) || (work.rowHeights.cols < box.width)) {
+		const int rows = std::max(work.rowHeights.rows, box.height);
+		const int cols = std::max(work.rowHeights.cols, box.width);
+		cv::Mat col(rows, 1, CV_16U);
+		for(int y=0;y<rows;y++) {
+			col.at<uint16_t>(y) = rows - y;
+		}
+		cv::repeat(col, 1, cols, work.rowHeights);
+		work.bin.create(rows, cols, CV_8U);
+		work.heights.create(rows, cols, CV_16U);
+		work.columnMax.create(1, cols, CV_16U);
 	}
 
-	return distance;
+	cv::Mat rowHeights = work.rowHeights(cv::Rect(0, work.rowHeights.rows - box.height, box.width, box.height));
+	cv::Mat bin = work.bin(cv::Rect(0, 0, box.width, box.height));
+	cv::Mat heights = work.heights(cv::Rect(0, 0, box.width, box.height));
+	cv::Mat columnMax = work.columnMax(cv::Rect(0, 0, box.width, 1));
+
+	/* Outputs of exactly the view's size and type are written in place */
+	cv::compare(mask(box), 127, bin, cv::CMP_GT);
+	heights.setTo(0);
+	rowHeights.copyTo(heights, bin);
+	cv::reduce(heights, columnMax, 0, cv::REDUCE_MAX);
+
+	const uint16_t* m = columnMax.ptr<uint16_t>(0);
+	for(int x=0;x<box.width;x++) {
+		profile[x] = m[x];
+	}
+}
+
+/* Mean of profile[begin, end), from its prefix sums. */
+static double spanMean(const std::vector<double>& prefix, size_t begin, size_t end) {
+	return (end > begin) ? ((prefix[end] - prefix[begin]) / (end - begin)) : 0;
 }
 
 /*!
- * \fn analyzeHeightProfile(std::vector<unsigned int> profile, unsigned int contourHeight)
+ * \fn analyzeHeightProfile(const std::vector<unsigned int>& profile, unsigned int contourHeight, height_profile_work& work)
  * \brief Find edges in a one-dimensional height profile.
+ *
+ * An edge is a run of columns where the mean of the prof_HalfSMA columns to the right differs from the mean of
+ * those to the left by more than profileEdgeThreshold * contourHeight. The first falling run, and the first
+ * rising run after it, are taken as the inside walls of the U. All window and state means come from one
+ * prefix sum array (kept in work.prefix, so that it is only reallocated when a longer profile comes along),
+ * so this is linear in the profile length.
  */
-goalProfileData analyzeHeightProfile(std::vector<unsigned int> profile, unsigned int contourHeight) {
-	// A sliding window algorithm is used to detect edges here:
-	
+goalProfileData analyzeHeightProfile(const std::vector<unsigned int>& profile, unsigned int contourHeight, height_profile_work& work) {
 	goalProfileData data;
+	const size_t n = profile.size();
+	if(n < 3) {
+		return data;
+	}
 
-	unsigned int slidingWindowMean = 0;
-	for(unsigned int i=0;i<prof_HalfSMA;i++) {
-		slidingWindowMean += profile[i];
+	std::vector<double>& prefix = work.prefix;
+	prefix.assign(n + 1, 0);
+	for(size_t i=0;i<n;i++) {
+		prefix[i+1] = prefix[i] + profile[i];
 	}
-	slidingWindowMean /= prof_HalfSMA;
 
-	unsigned int thres = (((double)contourHeight) * profileEdgeThreshold);
+	const double thres = ((double)contourHeight) * profileEdgeThreshold;
 
-	bool inEdge = false;
-	bool falling = false;
+	bool inFalling = false;
 	bool fallingFound = false;
-	for(unsigned int i=0;i<profile.length();i++) {
-		int begin = max(i-prof_HalfSMA, 0);
-		int end = min(i+prof_HalfSMA, profile.length());
-		// profile[end] is added to our window
-		// profile[begin] is dropped from our window
-		int nElem = end - begin;
-		slidingWindowMean += ((profile[end] / nElem) - (profile[begin] / nElem));
-
-		unsigned int diff = abs(profile[end] - slidingWindowMean);
-
-		if(!inEdge) {
-			if(diff > thres) { // start of edge
-				inEdge = true;
-				if(!fallingFound) {
-					data.fallingEdgeStart = end;
-					fallingFound = true;
-					falling = true;
-				} else {
-					data.risingEdgeStart = end;
+	bool inRising = false;
+	for(size_t i=1;i<n;i++) {
+		size_t begin = (i > prof_HalfSMA) ? (i - prof_HalfSMA) : 0;
+		size_t end = std::min(i + prof_HalfSMA, n);
+		double step = spanMean(prefix, i, end) - spanMean(prefix, begin, i);
+
+		if(!fallingFound) {
+			if(step < -thres) {
+				if(!inFalling) {
+					inFalling = true;
+					data.fallingEdgeStart = i;
 				}
+			} else if(inFalling) { // end of edge
+				inFalling = false;
+				fallingFound = true;
+				data.fallingEdgeEnd = i;
 			}
-		} else {
-			if(diff < thres) { // end of edge
-				inEdge = false;
-				if(falling) {
-					data.fallingEdgeEnd = end;
-					falling = false;
-				} else {
-					data.risingEdgeEnd = end;
-				}
+		} else if(step > thres) {
+			if(!inRising) {
+				inRising = true;
+				data.risingEdgeStart = i;
 			}
+		} else if(inRising) {
+			data.risingEdgeEnd = i;
+			data.found = true;
+			break;
 		}
 	}
 
-	// calculate more data:
-	for(unsigned int i=0;i<data.fallingEdgeStart;i++) {
-		data.averageHighState1 += profile[i];
-	}
-	data.averageHighState1 /= data.fallingEdgeStart;
-	
-	for(unsigned int i=data.fallingEdgeEnd;i<data.risingEdgeStart;i++) {
-		data.averageLowState += profile[i];
+	if(inRising && !data.found) { // rising edge runs to the end of the profile
+		data.risingEdgeEnd = n;
+		data.found = true;
 	}
-	data.averageLowState /= data.risingEdgeStart - data.fallingEdgeEnd;
 
-	for(unsigned int i=data.risingEdgeEnd;i<profile.length();i++) {
-		data.averageHighState2 += profile[i];
+	if(!data.found || (data.risingEdgeStart <= data.fallingEdgeEnd)) {
+		data.found = false;
+		return data;
 	}
-	data.averageHighState2 /= data.risingEdgeEnd - profile.length();
+
+	// calculate more data:
+	data.averageHighState1 = spanMean(prefix, 0, data.fallingEdgeStart);
+	data.averageLowState = spanMean(prefix, data.fallingEdgeEnd, data.risingEdgeStart);
+	data.averageHighState2 = spanMean(prefix, data.risingEdgeEnd, n);
 
 	return data;
 }
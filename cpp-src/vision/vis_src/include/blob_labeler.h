@@ -0,0 +1,80 @@
+#pragma once
+#include "rle_mask.h"
+#include "opencv2/core.hpp"
+#include <vector>
+
+/*! \file blob_labeler.h
+ *  \brief Single-pass connected-components labeling with per-blob statistics.
+ *
+ *  The contour engine edge-detects the mask, traces every edge with findContours, then walks each
+ *  point list again for contourArea, boundingRect and moments. The blob engine instead scans the
+ *  binary mask once, a run of set pixels at a time, and accumulates area, bounding box and raw
+ *  moments (up to second order) for each 8-connected blob as it goes. No point lists are built.
+ *
+ *  Blob statistics are taken over the filled region rather than along a traced outline, so areas
+ *  and moments are close to (but not identical to) the contour engine's for the same target.
+ */
+
+/*! \enum detect_engine
+ *  \brief Selects how the pipelines extract candidate targets from the preprocessed mask.
+ *
+ *  Plain enum (not enum class) so that the engine can be driven from a highgui trackbar.
+ */
+enum detect_engine {
+	ENGINE_CONTOURS = 0,	//!< Blur + Canny + findContours, then per-contour measurements (original chain).
+	ENGINE_BLOBS = 1,	//!< blob_labeler on the morphology output; no edge detection.
+	ENGINE_RLE = 2,		//!< As ENGINE_BLOBS, but the mask is run-length encoded from the threshold stage on (see rle_mask.h).
+	ENGINE_MAX = ENGINE_RLE
+};
+
+extern int visproc_detectEngine; //!< Currently selected detect_engine for the pipelines.
+
+/*! \struct blob_features
+ *  \brief Measurements of one blob, in the same units the contour engine computes them.
+ */
+struct blob_features {
+	double area;		//!< Pixel count.
+	cv::Rect bounds;	//!< Bounding box.
+	cv::Point2d centroid;	//!< Center of mass.
+	cv::Moments moments;	//!< Spatial, central and normalized moments up to second order (third order are left at 0).
+
+	/*! \fn outline(std::vector<cv::Point>& pts)
+	 *  \brief Write the bounding box as a closed 4-point contour, for callers that expect a point list.
+	 */
+	void outline(std::vector<cv::Point>& pts) const;
+};
+
+/*! \class blob_labeler
+ *  \brief Labels a binary mask and measures its blobs, reusing its storage from frame to frame.
+ */
+class blob_labeler {
+public:
+	void label(const cv::Mat& mask, cv::Point offset=cv::Point());
+	void label(const rle_mask& mask, cv::Point offset=cv::Point());
+	const std::vector<blob_features>& blobs() const { return results; };
+
+private:
+	struct run {
+		int x0;		//!< First set pixel.
+		int x1;		//!< One past the last set pixel.
+		int label;	//!< Provisional label.
+	};
+
+	struct accumulator {
+		double m00, m10, m01, m20, m11, m02;
+		int xMin, yMin, xMax, yMax;
+	};
+
+	std::vector<run> prevRuns;
+	std::vector<run> curRuns;
+	std::vector<int> parent;		//!< Union-find forest over provisional labels.
+	std::vector<accumulator> accum;		//!< Statistics per provisional label.
+	std::vector<blob_features> results;
+
+	int newLabel();
+	int find(int l);
+	void unite(int a, int b);
+	void addRun(int y, int x0, int x1, int l);
+	void labelRow(int y, cv::Point offset);
+	void collect();
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include "opencv2/core.hpp"
+#include <vector>
+#include <string>
+#include <utility>
+
+/*! \file camera_model.h
+ *  \brief Calibrated camera geometry, precomputed into per-column and per-row lookup tables.
+ *
+ *  The geometry helpers in common.cpp assume an ideal camera with the hardcoded fovHoriz / fovVert, so
+ *  they ignore lens distortion (which is significant towards the edges of a wide-angle webcam) and
+ *  evaluate tan / atan on every call. A camera_model is loaded from an OpenCV calibration file instead;
+ *  for the current resolution, it undistorts every pixel column along the center row and every pixel row
+ *  along the center column once, and stores the resulting ray directions. Angle and distance queries
+ *  are then table lookups (with linear interpolation between pixels).
+ *
+ *  Treating columns and rows separately is exact along the image's center lines and a close
+ *  approximation elsewhere, since distortion is mostly radial and small at the target's own extent.
+ *
+ *  The calibration file is the one written by OpenCV's calibration sample (cpp-example-calibration):
+ *  \code
+ *  %YAML:1.0
+ *  image_width: 640
+ *  image_height: 480
+ *  camera_matrix: !!opencv-matrix { rows: 3, cols: 3, dt: d, data: [ fx, 0, cx, 0, fy, cy, 0, 0, 1 ] }
+ *  distortion_coefficients: !!opencv-matrix { rows: 5, cols: 1, dt: d, data: [ k1, k2, p1, p2, k3 ] }
+ *  \endcode
+ *  If the camera is run at a different resolution with the same field of view, the intrinsics are scaled to match.
+ */
+class camera_model {
+public:
+	bool load(const std::string& path);
+	void setIdeal(cv::Size sz, double hfov, double vfov);
+	bool calibrated() const { return !cameraMatrix.empty(); };
+
+	void setResolution(cv::Size sz);
+	cv::Size getResolution() const { return size; };
+
+	/*! \fn columnAngle(double x)
+	 *  \brief Horizontal angle (radians, positive to the right) between the optical axis and the ray through column x.
+	 */
+	double columnAngle(double x) const { return lookup(colAngles, x); };
+
+	/*! \fn rowAngle(double y)
+	 *  \brief Vertical angle (radians, positive downwards) between the optical axis and the ray through row y.
+	 */
+	double rowAngle(double y) const { return lookup(rowAngles, y); };
+
+	double distanceFromRows(double top, double bottom, double targetHeight) const;
+	double distanceFromColumns(double left, double right, double targetWidth) const;
+
+	std::pair<double, double> projectToGroundPlane(cv::Point2f imgPoint, double cameraHeight, double cameraTilt) const;
+
+	double horizFOV() const;
+	double vertFOV() const;
+
+private:
+	cv::Mat cameraMatrix;
+	cv::Mat distCoeffs;
+	cv::Size calibSize;
+	cv::Size size;
+
+	/* Indexed by pixel coordinate 0 .. width (or height), so that the far edge of a bounding box is covered */
+	std::vector<double> colTan;	//!< Normalized (undistorted) x of each column's ray, i.e. tan(columnAngle).
+	std::vector<double> colAngles;
+	std::vector<double> rowTan;
+	std::vector<double> rowAngles;
+
+	static double lookup(const std::vector<double>& table, double p);
+};
+
+extern camera_model visproc_camera; //!< Camera used by the geometry helpers once calibrated() (see camera_model::load).
@@ -0,0 +1,34 @@
+#pragma once
+#include "opencv2/core.hpp"
+
+/*! \file change_detector.h
+ *  \brief Cheap test for whether a camera frame differs meaningfully from an earlier one.
+ */
+
+/*! \class frame_change_detector
+ *  \brief Compares tiny thumbnails of successive frames, so that unchanged frames can skip processing.
+ *
+ *  Each frame is area-averaged down to thumbSize and compared against the thumbnail of the last frame
+ *  that was reported as changed (not simply the previous frame, so slow drift still adds up to a change).
+ *  A frame counts as changed if the mean absolute difference over all thumbnail cells and channels
+ *  exceeds meanThreshold, or if any single cell / channel differs by more than cellThreshold (so a
+ *  small target moving in an otherwise still scene is not missed).
+ */
+class frame_change_detector {
+public:
+	cv::Size thumbSize = cv::Size(16, 12);	//!< Thumbnail size; each cell averages a 40x40 block of a 640x480 frame.
+	double meanThreshold = 2.0;		//!< Maximum mean absolute difference (in 8-bit levels) for an unchanged frame.
+	double cellThreshold = 24.0;		//!< Maximum difference of any one cell and channel for an unchanged frame.
+	unsigned int maxSkipped = 15;		//!< Frames in a row that may be reported unchanged before one is forced through.
+
+	bool changed(const cv::Mat& frame);
+	void reset();
+
+	unsigned int getSkipped() const { return skipped; };
+
+private:
+	cv::Mat thumb;
+	cv::Mat reference;	//!< Thumbnail of the last frame reported as changed.
+	cv::Mat diff;
+	unsigned int skipped = 0;
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include "hsv_threshold.h"
+#include "opencv2/core.hpp"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+
+/*! \file color_lut.h
+ *  \brief Precomputed BGR -> mask membership tables for HSV thresholding.
+ *
+ *  The HSV bounds used by the pipelines change rarely (trackbars, tuning), so rather than
+ *  converting every pixel to HSV on every frame, the bounds are baked into a table indexed
+ *  by the raw BGR value. Classifying a pixel is then a single table load.
+ */
+
+/*! \enum lut_resolution
+ *  \brief Table index quantization.
+ */
+enum lut_resolution {
+	LUT_BGR888 = 0,	//!< Full 24-bit index, stored as a 2 MB bitset. Exact.
+	LUT_BGR565 = 1,	//!< 5-6-5 bit index, stored as a 64 KB byte table. Each cell is classified by its center color.
+};
+
+/*! \class hsv_color_lut
+ *  \brief Color classifier that rebuilds its table when its HSV bounds change.
+ *
+ *  A full 24-bit table takes a noticeable fraction of a second to build on the ARM boards, so only the first
+ *  build (or the first after invalidate()) happens inside update(). Later bounds changes are built on a
+ *  background thread into a second table, and frames keep being classified with the old one until the
+ *  new one is swapped in by a later update(). While a trackbar is being dragged, at most one build runs at
+ *  a time, and the latest bounds are built next.
+ *
+ *  update() is the only call that changes the table in use, so it marks the frame boundary: call it once per
+ *  frame, before classifying, and have everything within the frame (e.g. the strips of strip-parallel
+ *  preprocessing) call only apply(), which is read-only. Every apply() between two update() calls then uses the
+ *  same table, and strips come out as if the frame had been classified in one piece. Both may be called
+ *  from several threads at once.
+ */
+class hsv_color_lut {
+public:
+	hsv_color_lut(lut_resolution res=LUT_BGR888) : resolution(res) {};
+	hsv_color_lut(const hsv_color_lut&) = delete;
+	hsv_color_lut& operator=(const hsv_color_lut&) = delete;
+	~hsv_color_lut();
+
+	bool asyncRebuild = true;	//!< If false, update() always rebuilds in place, as before the first build.
+
+	bool update(const hsv_range& range);
+	void invalidate();
+	void apply(const cv::Mat& bgr, cv::Mat& mask) const;
+	void apply(const cv::Mat& bgr, rle_mask& mask) const;
+
+	lut_resolution getResolution() const { return resolution; };
+	hsv_range getRange() const;
+
+private:
+	typedef std::vector<uint8_t> lut_table;
+
+	/* Test a single BGR pixel against a table of this resolution. */
+	bool classify(const uint8_t* table, unsigned char b, unsigned char g, unsigned char r) const {
+		if(resolution == LUT_BGR565) {
+			return table[((b >> 3) << 11) | ((g >> 2) << 5) | (r >> 3)] != 0;
+		}
+		uint32_t idx = (uint32_t(b) << 16) | (uint32_t(g) << 8) | r;
+		return (table[idx >> 3] >> (idx & 7)) & 1;
+	};
+
+	std::shared_ptr<const lut_table> current() const;
+	void finishBuild();
+
+	static void build(lut_resolution res, const hsv_range& range, lut_table& out);
+	static void build888(const hsv_range& range, lut_table& out);
+	static void build565(const hsv_range& range, lut_table& out);
+
+	lut_resolution resolution;
+
+	mutable std::mutex lock;		//!< Guards everything below except the contents of pending while building.
+	std::shared_ptr<const lut_table> table;	//!< Table in use; empty until the first build, or after invalidate().
+	hsv_range built;			//!< Bounds table was built for.
+
+	std::thread builder;			//!< Background build of pending, if building.
+	bool building = false;
+	std::atomic<bool> pendingDone{false};	//!< Set by builder when pending is complete.
+	std::shared_ptr<lut_table> pending;
+	hsv_range pendingRange;			//!< Bounds pending is being built for.
+};
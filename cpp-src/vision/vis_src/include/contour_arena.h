@@ -0,0 +1,114 @@
+#pragma once
+#include "contour_descriptor.h"
+#include "opencv2/core.hpp"
+#include <vector>
+#include <stdint.h>
+
+struct CvMemStorage;
+
+/*! \file contour_arena.h
+ *  \brief Per-frame contour storage with every point in one reusable buffer.
+ *
+ *  cv::findContours traces into a newly created CvMemStorage, then copies each contour into its own
+ *  std::vector, so every frame costs one heap allocation per contour (and more as they are moved and
+ *  copied around). A contour_arena keeps one CvMemStorage for its whole life and copies the traced points
+ *  into a single std::vector<cv::Point>; once its buffers have grown to fit a typical frame, extracting
+ *  contours allocates nothing.
+ *
+ *  Contours are handed out as cv::Mat headers over the shared buffer (which every OpenCV contour function
+ *  accepts as a point list), and scored detections as contour_record values that refer into it by offset.
+ *  Records stay valid until clear(), which the pipelines call once per frame.
+ *
+ *  extractBounded() keeps the cost of a pathological frame (glare, or a threshold that lets the whole
+ *  scene through) bounded: see contour_limits.
+ */
+
+/*! \struct contour_limits
+ *  \brief Caps on the contour extraction work done for one image.
+ *
+ *  Tracing time and the total number of contour points both grow with the number of edge pixels, which
+ *  countNonZero() measures cheaply up front. Above maxEdgePixels, the image is either subsampled by 2, 4, 8...
+ *  until it is under the cap (coordinates are scaled back up afterwards, so areas and bounds stay in frame
+ *  units at reduced precision), or skipped. The remaining caps then bound
+ *  the scoring work; maxContours also caps the blobs scored by the blob engines. A value of 0 disables a cap.
+ *  Whenever a cap takes effect, the arena is marked degraded, and the pipelines report it per frame in
+ *  visproc_context::frameDegraded (and target_detection::degraded).
+ */
+struct contour_limits {
+	size_t maxEdgePixels = 100000;		//!< Edge pixels before the image is subsampled (about a third of 640x480).
+	size_t maxContours = 1000;		//!< Contours (or blobs) kept; beyond this, only the longest (largest) are kept.
+	size_t maxContourPoints = 10000;	//!< Contours with more points than this are dropped.
+	bool subsample = true;			//!< If false, images over maxEdgePixels are skipped instead of subsampled.
+};
+
+/*! \struct contour_record
+ *  \brief A scored detection: its measurements (see contour_descriptor), plus the location of its points in a contour_arena.
+ */
+struct contour_record : public contour_descriptor {
+	double score = 0;
+	uint32_t offset = 0;	//!< Index of the first point in the arena.
+	uint32_t length = 0;	//!< Number of points.
+};
+
+/*! \class contour_arena
+ *  \brief Contours traced from one or more binary images, stored contiguously.
+ *
+ *  Mat headers from contour() point straight into the buffer, so they are only valid until the next
+ *  extract(), append() or clear(). Copying an arena copies its points but not its trace storage.
+ */
+class contour_arena {
+public:
+	contour_arena() {};
+	contour_arena(const contour_arena& other);
+	contour_arena& operator=(const contour_arena& other);
+	~contour_arena();
+
+	void clear();
+	size_t extract(cv::Mat& image, cv::Point offset=cv::Point(), int scale=1, bool externalOnly=false);
+	size_t extractBounded(const cv::Mat& image, cv::Mat& work, cv::Point offset, const contour_limits& limits);
+	uint32_t append(const std::vector<cv::Point>& pts);
+
+	size_t size() const { return spans.size(); };			//!< Number of contours.
+	size_t totalPoints() const { return points.size(); };
+
+	/*! \fn degraded()
+	 *  \brief Whether a contour_limits cap took effect since the last clear(), so that contours may be missing or coarse.
+	 */
+	bool degraded() const { return overLimit; };
+
+	/*! \fn contour(size_t i)
+	 *  \brief Contour i as an n x 1 CV_32SC2 Mat over the arena's buffer (no copy).
+	 */
+	cv::Mat contour(size_t i) const { return view(spans[i].offset, spans[i].length); };
+	cv::Mat contour(const contour_record& r) const { return view(r.offset, r.length); };
+
+	/*! \fn maxArea(size_t i)
+	 *  \brief Upper bound on the area of contour i, from its point count alone (without reading its points).
+	 *
+	 *  Traced points are 8-neighbours (scale pixels apart in a subsampled image), so the perimeter is at most
+	 *  n * sqrt(2) * scale, and by the isoperimetric inequality the area is at most perimeter^2 / (4 pi).
+	 */
+	double maxArea(size_t i) const {
+		const double r = (double)spans[i].length * spans[i].scale;
+		return (r * r) / (2 * CV_PI);
+	};
+
+	contour_record record(size_t i, double score, const contour_descriptor& d) const;
+	void copyTo(const contour_record& r, std::vector<cv::Point>& out) const;
+
+private:
+	struct span {
+		uint32_t offset;
+		uint32_t length;
+		uint32_t scale;	//!< Subsampling factor the contour was traced at.
+	};
+
+	CvMemStorage* storage = NULL;	//!< Reused by every extract(); created on first use.
+	std::vector<cv::Point> points;
+	std::vector<span> spans;
+	bool overLimit = false;
+
+	cv::Mat view(uint32_t offset, uint32_t length) const {
+		return cv::Mat(length, 1, CV_32SC2, const_cast<cv::Point*>(points.data() + offset));
+	};
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include "opencv2/core.hpp"
+#include <vector>
+#include <stddef.h>
+
+/*! \file contour_descriptor.h
+ *  \brief Single-pass shape measurements for a contour.
+ *
+ *  Scoring a contour used to walk its point list once each for cv::contourArea, cv::arcLength,
+ *  cv::boundingRect and cv::moments, and the distance and angle helpers walked the winner's points again.
+ *  describeContour() measures all of them in one loop over the points, and the result travels with the
+ *  detection (see contour_record), so nothing downstream needs the points to measure it again.
+ *
+ *  The values match OpenCV's: area and moments use the same polygon (Green's theorem) formulas as
+ *  cv::contourArea and cv::moments, and perimeter is that of the closed polygon, as cv::arcLength(c, true).
+ *  Like the blob engine's, the moments are computed up to second order (third order are left at 0);
+ *  none of the scoring tests use more.
+ */
+
+/*! \struct contour_descriptor
+ *  \brief Measurements of one contour (or blob), in frame coordinates.
+ */
+struct contour_descriptor {
+	double area = 0;	//!< Enclosed area (always positive).
+	double perimeter = 0;	//!< Length of the closed outline.
+	cv::Rect bounds;	//!< Bounding box.
+	cv::Moments moments;	//!< Spatial, central and normalized moments up to second order.
+
+	/*! \fn centroid()
+	 *  \brief Center of mass, or the middle of the bounding box for a contour with no area.
+	 */
+	cv::Point2d centroid() const {
+		if(moments.m00 == 0) {
+			return cv::Point2d(bounds.x + (bounds.width / 2.0), bounds.y + (bounds.height / 2.0));
+		}
+		return cv::Point2d(moments.m10 / moments.m00, moments.m01 / moments.m00);
+	};
+};
+
+/*! \fn secondOrderMoments(double m00, double m10, double m01, double m20, double m11, double m02)
+ *  \brief cv::Moments from raw moments up to second order, with every third-order field zeroed.
+ *
+ *  The cv::Moments constructor derives mu30..mu03 and nu30..nu03 from the third-order raw moments
+ *  combined with the lower orders, so passing 0 for m30..m03 leaves those fields non-zero; they are
+ *  cleared here instead.
+ */
+inline cv::Moments secondOrderMoments(double m00, double m10, double m01, double m20, double m11, double m02) {
+	cv::Moments m(m00, m10, m01, m20, m11, m02, 0, 0, 0, 0);
+	m.mu30 = m.mu21 = m.mu12 = m.mu03 = 0;
+	m.nu30 = m.nu21 = m.nu12 = m.nu03 = 0;
+	return m;
+}
+
+extern void describeContour(const cv::Point* pts, size_t n, contour_descriptor& out);
+extern void describeContour(const cv::Mat& contour, contour_descriptor& out);
+extern void describeContour(const std::vector<cv::Point>& contour, contour_descriptor& out);
@@ -0,0 +1,89 @@
+#pragma once
+#include "rle_mask.h"
+#include "opencv2/core.hpp"
+
+/*! \file hsv_threshold.h
+ *  \brief Fused BGR -> HSV color thresholding kernels.
+ *
+ *  The legacy preprocessing chain runs cvtColor to a 3-channel HSV frame, blurs all three
+ *  channels, then runs inRange to get a 1-channel mask. The fused kernels here read the
+ *  BGR frame and write the binary mask directly, in a single pass over each row.
+ *
+ *  Tolerances vs. the legacy chain:
+ *  - THRES_FUSED is bit-exact with cv::cvtColor(CV_BGR2HSV) + cv::inRange on the same input
+ *    (it uses the same fixed-point division tables as OpenCV's 8-bit conversion). THRES_LUT's full
+ *    24-bit table is built from the same conversion, so it classifies exactly as THRES_FUSED.
+ *  - THRES_FUSED_SIMD computes H and S in single-precision floats; a pixel whose H or S lands
+ *    exactly on a rounding boundary may be classified as if H or S were off by one.
+ *  - Measured over all 2^24 BGR colors: THRES_FUSED matches cvtColor + inRange on every one;
+ *    THRES_FUSED_SIMD differs from it on 3507 colors (0.02%) with the default goal thresholds
+ *    (H 70-100, V 128-255), and on none with the default ball thresholds.
+ *
+ *  Beyond rounding, the fused and LUT modes behave differently from THRES_LEGACY: they skip its
+ *  GaussianBlur of the HSV image (Target::hsvBlurSize: 5x5, sigma 2.5 for goals; 3x3, sigma 1.5 for boulders). The legacy
+ *  blur spreads a mask up to two pixels past bright edges, and turns a noisy region whose color is
+ *  within the noise of a threshold into a solid blob (or removes it) as a whole; the fused modes
+ *  leave such a region speckled, which the pipelines' erosion then mostly removes.
+ *
+ *  Measured tolerance, fused (and SIMD) vs. legacy, goal thresholds, 5x5 erosion: 200 synthetic
+ *  640x480 frames per condition, each a U of goal-colored tape 60-240 px wide on a dark background,
+ *  lens-blurred (sigma 0.5-1.5 px), with Gaussian noise of sigma 2, 5 and 10:
+ *  - goal alone: 0.11% of pixels differ on average (0.26% at most) before erosion, 0.25% at most
+ *    after; differing eroded pixels lie up to 31 px from an edge of the legacy mask, where the tape
+ *    meets the frame border;
+ *  - with six rectangles of random color added: 0.26-0.50% on average (2.5% at most) before erosion,
+ *    3.7% at most after, up to 53 px from a legacy edge (whole near-threshold rectangles).
+ *  These were taken with OpenCV 4.11's conversion, blur and morphology, not on camera frames; for the
+ *  camera in use, goalproc-basic --compare-threshold measures the same quantities on live frames.
+ */
+
+/*! \enum threshold_mode
+ *  \brief Selects how the preprocessing pipelines compute their color mask.
+ *
+ *  Plain enum (not enum class) so that the mode can be driven from a highgui trackbar.
+ */
+enum threshold_mode {
+	THRES_LEGACY = 0,	//!< cvtColor + GaussianBlur + inRange (original multi-pass chain).
+	THRES_FUSED = 1,	//!< Single-pass scalar kernel.
+	THRES_FUSED_SIMD = 2,	//!< Single-pass kernel using 4-wide vector arithmetic.
+	THRES_LUT = 3,		//!< Precomputed BGR color-membership table (see color_lut.h).
+	THRES_MODE_MAX = THRES_LUT
+};
+
+extern int visproc_thresholdMode; //!< Currently selected threshold_mode for the preprocessing pipelines.
+
+/*! \struct hsv_range
+ *  \brief Inclusive HSV bounds, in OpenCV 8-bit units (H: 0-179, S and V: 0-255).
+ */
+struct hsv_range {
+	unsigned char min[3];	//!< Minimum H, S, V.
+	unsigned char max[3];	//!< Maximum H, S, V.
+
+	hsv_range() : hsv_range(0, 0, 0, 0, 0, 0) {};
+	hsv_range(int hMin, int hMax, int sMin, int sMax, int vMin, int vMax) {
+		min[0] = hMin; min[1] = sMin; min[2] = vMin;
+		max[0] = hMax; max[1] = sMax; max[2] = vMax;
+	}
+
+	bool operator==(const hsv_range& rhs) const {
+		return (min[0] == rhs.min[0]) && (min[1] == rhs.min[1]) && (min[2] == rhs.min[2]) &&
+			(max[0] == rhs.max[0]) && (max[1] == rhs.max[1]) && (max[2] == rhs.max[2]);
+	}
+	bool operator!=(const hsv_range& rhs) const { return !(*this == rhs); }
+
+	/*! \fn contains(const unsigned char* hsv)
+	 *  \brief Test whether an HSV pixel lies within these bounds.
+	 */
+	bool contains(const unsigned char* hsv) const {
+		return (hsv[0] >= min[0]) && (hsv[0] <= max[0]) &&
+			(hsv[1] >= min[1]) && (hsv[1] <= max[1]) &&
+			(hsv[2] >= min[2]) && (hsv[2] <= max[2]);
+	}
+};
+
+extern void bgrToHSV8U(const unsigned char* bgr, unsigned char* hsv);
+extern void fusedHSVThreshold(const cv::Mat& bgr, cv::Mat& mask, const hsv_range& range, int mode=THRES_FUSED);
+extern void fusedHSVThreshold(const cv::Mat& bgr, rle_mask& mask, const hsv_range& range, int mode=THRES_FUSED);
+
+const int MULTI_THRES_MAX = 8;	//!< Most ranges multiHSVThreshold() can test in one pass.
+extern void multiHSVThreshold(const cv::Mat& bgr, cv::Mat* masks, const hsv_range* ranges, int n, int mode=THRES_FUSED);
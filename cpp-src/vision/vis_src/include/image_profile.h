@@ -1,10 +1,31 @@
 #pragma once
 #include "opencv2/core.hpp"
-#include "opencv2/imgproc.hpp"
-#include "opencv2/imgcodecs.hpp"
 #include <vector>
 
-extern std::vector<unsigned int> particleHeightProfile(std::vector<cv::Point> contour); //!< Contour column size profile datatype
+/*! \file image_profile.h
+ *  \brief Column height profiles of a candidate's mask, for checking its shape.
+ *
+ *  The goal's tape is a U: seen column by column from the bottom of its bounding box, the mask reaches
+ *  all the way up at either side and only the width of the tape in between. The height profile of a
+ *  candidate is that extent for every column of its bounding box, read straight from the binary mask
+ *  with whole-image operations (no contour walking), and analyzeHeightProfile() finds the falling and
+ *  rising edges of the U in it in linear time.
+ */
+
+/*! \struct height_profile_work
+ *  \brief Scratch buffers for particleHeightProfile() and analyzeHeightProfile(); reuse one per thread to avoid reallocating them.
+ *
+ *  The image buffers grow to fit the largest box profiled so far, and are used through views of their corners.
+ */
+struct height_profile_work {
+	cv::Mat bin;		//!< Mask pixels inside the bounding box, as 0 / 255.
+	cv::Mat rowHeights;	//!< Height above the bottom of the box of every pixel (CV_16U).
+	cv::Mat heights;	//!< rowHeights where the mask is set, else 0.
+	cv::Mat columnMax;	//!< Per-column maximum of heights.
+	std::vector<double> prefix;	//!< Prefix sums of the profile being analyzed.
+};
+
+extern void particleHeightProfile(const cv::Mat& mask, const cv::Rect& bounds, std::vector<unsigned int>& profile, height_profile_work& work);
 
 // profile analysis:
 // Change of > 10% of total contour height : edge
@@ -18,20 +39,22 @@ extern std::vector<unsigned int> particleHeightProfile(std::vector<cv::Point> co
  * \brief Holds data extracted from image column profiling
  */
 struct goalProfileData {
-	unsigned int fallingEdgeStart;
-	unsigned int fallingEdgeEnd;
+	bool found = false;		//!< Whether a falling edge followed by a rising edge was found; the rest is only valid if so.
+
+	unsigned int fallingEdgeStart = 0;	//!< First column of the falling edge.
+	unsigned int fallingEdgeEnd = 0;	//!< One past its last column.
 
-	unsigned int risingEdgeStart;
-	unsigned int risingEdgeEnd;
+	unsigned int risingEdgeStart = 0;
+	unsigned int risingEdgeEnd = 0;
 
-	unsigned int averageHighState1;
-	unsigned int averageLowState;
-	unsigned int averageHighState2;
+	double averageHighState1 = 0;	//!< Mean height left of the falling edge.
+	double averageLowState = 0;	//!< Mean height between the edges.
+	double averageHighState2 = 0;	//!< Mean height right of the rising edge.
 };
 
-// half the size of the sliding window, rounded down.
-// this gives us a total sliding window of 2(2) + 1 = 5 (1 central value and 2 values on either side)
+// half the size of the edge detector's window, on either side of each column.
+// edges are found where the mean of the 2 columns on one side differs from the mean of the 2 on the other.
 const unsigned int prof_HalfSMA = 2;		//!< Half of sliding window size.
 const double profileEdgeThreshold = 0.10;	//!< Percentage difference (of max contour height) to consider an "edge"
 
-extern goalProfileData analyzeHeightProfile(std::vector<unsigned int> profile, unsigned int contourHeight)
+extern goalProfileData analyzeHeightProfile(const std::vector<unsigned int>& profile, unsigned int contourHeight, height_profile_work& work);
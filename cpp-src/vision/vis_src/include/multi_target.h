@@ -0,0 +1,97 @@
+#pragma once
+#include "visproc_context.h"
+#include "target_pipeline.h"
+#include "color_lut.h"
+#include "opencv2/core.hpp"
+#include <vector>
+
+/*! \file multi_target.h
+ *  \brief Searching one frame for several target types, sharing the color conversion between them.
+ *
+ *  Running goal_preprocess_pipeline and boulder_preprocess_pipeline on the same frame converts it to
+ *  HSV twice. A multi_target_detector instead thresholds the frame for every registered target in one
+ *  pass, then runs each target's own morphology, edge detection and scoring on its mask.
+ *
+ *  How the shared threshold is computed depends on visproc_thresholdMode:
+ *  - THRES_FUSED, THRES_FUSED_SIMD: multiHSVThreshold(); each pixel is converted once and tested against
+ *    every target's range. Masks are identical to the single-target pipelines.
+ *  - THRES_LEGACY: one cvtColor and one Gaussian blur, using the first registered target's blur parameters,
+ *    then an inRange per target. Other targets' masks may differ slightly from their own pipelines'.
+ *  - THRES_LUT: there is no conversion to share, so each target's table is applied in turn.
+ *
+ *  The whole frame is always searched; ROI tracking and ctx.preprocess are not used.
+ */
+
+/*! \struct target_class
+ *  \brief A target type registered with a multi_target_detector; see make_target_class().
+ */
+struct target_class {
+	const char* name;
+	hsv_range (*range)();
+	hsv_color_lut& (*colorLUT)();
+	cv::Mat& (*processMask)(visproc_context& ctx, bool live_output);	//!< Everything after the threshold (see target_process_mask).
+	void (*score)(cv::Mat input, cv::Point offset, visproc_context& ctx, bool suppress_output, bool window_output, size_t topK);
+
+	cv::Size hsvBlurSize;	//!< THRES_LEGACY blur, used if this is the first target.
+	double hsvBlurSigma;
+	int hsvBlurBorder;
+};
+
+/*! \fn make_target_class(const char* name)
+ *  \brief Build the target_class for a target_pipeline.h policy.
+ */
+template<class Target>
+target_class make_target_class(const char* name) {
+	target_class t;
+	t.name = name;
+	t.range = &Target::range;
+	t.colorLUT = &Target::colorLUT;
+	t.processMask = &target_process_mask<Target>;
+	t.score = &target_score<Target>;
+	t.hsvBlurSize = cv::Size(Target::hsvBlurSize, Target::hsvBlurSize);
+	t.hsvBlurSigma = Target::hsvBlurSigma;
+	t.hsvBlurBorder = Target::hsvBlurBorder;
+	return t;
+}
+
+extern target_class goal_target_class();
+extern target_class boulder_target_class();
+
+/*! \struct target_detection
+ *  \brief One scored candidate from a multi_target_detector.
+ */
+struct target_detection {
+	int target;			//!< Index of the target_class, in the order they were added.
+	double score;
+	std::vector<cv::Point> points;	//!< Contour (or blob outline), in frame coordinates.
+	contour_descriptor shape;	//!< Area, perimeter, bounding box and moments, as measured while scoring.
+	bool degraded = false;		//!< Whether its frame hit a contour_limits cap, so that candidates may be missing or coarse.
+};
+
+/*! \class multi_target_detector
+ *  \brief Finds every registered target type in a frame, with a single shared color conversion.
+ *
+ *  Each target gets its own visproc_context, so buffers are reused across frames as with the
+ *  single-target pipelines. Not thread-safe; use one per processing thread.
+ */
+class multi_target_detector {
+public:
+	int addTarget(const target_class& target);
+
+	const std::vector<target_detection>& detect(cv::Mat frame, bool suppress_output=false, bool live_output=false);
+
+	size_t targetCount() const { return targets.size(); };
+	const target_class& getTarget(int i) const { return targets[i]; };
+	visproc_context& getContext(int i) { return contexts[i]; };
+
+private:
+	void threshold(cv::Mat frame, bool live_output);
+
+	std::vector<target_class> targets;
+	std::vector<visproc_context> contexts;
+
+	cv::Mat hsv;				//!< Shared HSV conversion (THRES_LEGACY only).
+	std::vector<cv::Mat> masks;		//!< One threshold mask per target; shared with each context's mask.
+	std::vector<hsv_range> ranges;
+	std::vector<target_detection> detections;
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include "camera_model.h"
+#include "opencv2/core.hpp"
+#include <vector>
+#include <stdint.h>
+
+/*! \file obsdetect.h
+ *  \brief Obstacle masking by comparison with a reference patch of floor.
+ *
+ *  The trapezoid of image just in front of the robot (obs_refTrapezoid) is assumed to be clear floor.
+ *  HSV histograms of that patch are folded into a floor model (obstacle_model), and any pixel whose value,
+ *  saturation or hue is rare in the model is marked as an obstacle:
+ *
+ *  - a value seen fewer than obs_valHistBinThres times in the patch is an obstacle;
+ *  - otherwise, if the pixel is bright enough (value >= obs_valThres), a saturation seen fewer than
+ *    obs_satHistBinThres times is an obstacle;
+ *  - otherwise, if it is also saturated enough (saturation >= obs_satThres), a hue seen fewer than
+ *    obs_hueHistBinThres times is an obstacle.
+ *
+ *  The model is folded into 256-entry tables per channel each frame, so classifying a frame is a few
+ *  whole-plane table lookups (cv::LUT) and bitwise operations, with no per-pixel branches.
+ *
+ *  Only the trapezoid's row spans are scanned for the histograms, so their cost is proportional to the
+ *  patch rather than the frame. With obstacle_context::decay, the model is an exponentially decayed
+ *  average of past patches, so that flicker or a passing shadow doesn't flip the whole mask; with
+ *  obstacle_context::refreshEvery, the patch is only rescanned every Nth frame.
+ *
+ *  For navigation, obs_freeSpace() reduces the mask to a polar scan: for each of a fixed number of bearings
+ *  across the field of view, the ground distance from the camera to the nearest obstacle, found by projecting
+ *  the lowest obstacle pixel of each column onto the floor.
+ */
+
+extern std::vector<cv::Point> createTrapezoid(unsigned int topWidth, unsigned int baseWidth, unsigned int height, cv::Point bottomLeft);
+
+extern const std::vector<cv::Point> obs_refTrapezoid;	//!< Reference floor patch, for 640x480 frames.
+extern const unsigned int obs_valThres;	//!< Minimum value for the saturation test to apply.
+extern const unsigned int obs_satThres;	//!< Minimum saturation for the hue test to apply.
+
+extern int obs_valHistBinThres;		//!< Value histogram count below which a pixel is an obstacle.
+extern int obs_satHistBinThres;		//!< Saturation histogram count below which a pixel is an obstacle.
+extern int obs_hueHistBinThres;		//!< Hue histogram count below which a pixel is an obstacle.
+
+extern double obs_cameraHeight;		//!< Height of the camera above the floor, in inches.
+extern double obs_cameraTilt;		//!< Downward tilt of the camera, in radians.
+
+/*! \struct obstacle_histograms
+ *  \brief HSV histograms of the reference patch in one frame.
+ */
+struct obstacle_histograms {
+	unsigned int hue[256];	//!< Hues of pixels passing both the value and saturation gates.
+	unsigned int sat[256];	//!< Saturations of pixels passing the value gate.
+	unsigned int val[256];
+
+	void clear();
+};
+
+/*! \struct obstacle_model
+ *  \brief Floor appearance: reference patch histograms, averaged over time, in pixels per frame.
+ */
+struct obstacle_model {
+	float hue[256];
+	float sat[256];
+	float val[256];
+	bool valid = false;	//!< Whether any frame has been added yet.
+
+	void update(const obstacle_histograms& h, float decay);
+};
+
+/*! \struct obstacle_span
+ *  \brief One row of the reference patch: pixels [x0, x1) of row y.
+ */
+struct obstacle_span {
+	int y;
+	int x0;
+	int x1;
+};
+
+/*! \struct obstacle_context
+ *  \brief Buffers and tables for obstacle detection, reused from frame to frame.
+ */
+struct obstacle_context {
+	cv::Mat blurred;		//!< Blurred input frame.
+	cv::Mat hsv;			//!< HSV conversion of blurred.
+	cv::Size refSize;		//!< Frame size refSpans were built for.
+	std::vector<obstacle_span> refSpans;	//!< Rows of obs_refTrapezoid (as filled by cv::fillConvexPoly), clipped to the frame.
+	cv::Mat mask;			//!< Obstacle mask: 255 for obstacles, 0 for floor.
+
+	float decay = 0;		//!< Weight of the existing model at each refresh (0-1); 0 replaces it with the newest patch.
+	unsigned int refreshEvery = 1;	//!< Rescan the patch every this many frames; the model is reused in between.
+	unsigned int frameCount = 0;	//!< Frames processed since the model was last reset.
+
+	obstacle_histograms hist;	//!< Reference histograms of the last scanned frame.
+	obstacle_model model;		//!< Floor model the tables are built from.
+	cv::Mat hueReject;		//!< 256-entry table: 255 for rare hues.
+	cv::Mat satReject;		//!< 255 for rare saturations.
+	cv::Mat satGate;		//!< 255 for saturations high enough for the hue test to apply.
+	cv::Mat valReject;		//!< 255 for rare values.
+	cv::Mat valGate;		//!< 255 for values high enough for the saturation test to apply.
+	cv::Mat channels[3];		//!< hsv, split into hue, saturation and value planes.
+	cv::Mat test;			//!< Scratch: one table applied to one plane.
+};
+
+/*! \struct free_space_scan
+ *  \brief Distance to the nearest obstacle at evenly spaced bearings, and the tables used to find it.
+ *
+ *  Bin i covers bearings [startAngle + i*angleStep, startAngle + (i+1)*angleStep), in radians, positive to
+ *  the right of the optical axis. The tables only depend on the frame size, bin count and camera mounting,
+ *  and are rebuilt when any of those change.
+ */
+struct free_space_scan {
+	double startAngle = 0;
+	double angleStep = 0;
+	std::vector<float> range;	//!< Ground distance to the nearest obstacle in each bin, in inches; infinity if none is in view.
+
+	cv::Size size;			//!< Frame size the tables were built for.
+	double height = 0;		//!< Camera height the tables were built for.
+	double tilt = 0;		//!< Camera tilt the tables were built for.
+	bool calibrated = false;	//!< Whether the tables came from visproc_camera.
+	camera_model ideal;		//!< Nominal camera the tables come from while visproc_camera isn't calibrated.
+	std::vector<float> rowDist;	//!< Forward distance to the floor under the bottom edge of each row; infinity at or above the horizon.
+	std::vector<float> rowLateral;	//!< Lateral offset of the floor under the bottom edge of each row, at the frame's right edge.
+	std::vector<float> colLateral;	//!< Lateral offset of each column's floor point, as a fraction of rowLateral.
+	std::vector<int> binStart;	//!< First column of each bin; binStart[i+1] is one past its last.
+
+	cv::Mat bin;			//!< Mask pixels as 0 / 255.
+	cv::Mat rowRamp;		//!< Row index + 1 of every pixel (CV_16U).
+	cv::Mat rows;			//!< rowRamp where the mask is set, else 0.
+	cv::Mat lowest;			//!< Per-column maximum of rows: the lowest obstacle row + 1, or 0 for none.
+};
+
+extern void obs_getReferenceHistograms(const cv::Mat& hsv, obstacle_context& ctx);
+extern void obs_resetModel(obstacle_context& ctx);
+extern void obs_buildLUTs(obstacle_context& ctx);
+extern void obs_classify(const cv::Mat& hsv, obstacle_context& ctx);
+
+extern cv::Mat& obs_getObsMask(cv::Mat src, obstacle_context& ctx);
+extern cv::Mat obs_getObsMask(cv::Mat src);
+
+extern void obs_freeSpace(const cv::Mat& mask, unsigned int nBins, free_space_scan& scan);
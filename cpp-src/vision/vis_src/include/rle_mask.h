@@ -0,0 +1,70 @@
+#pragma once
+#include "opencv2/core.hpp"
+#include <vector>
+
+/*! \file rle_mask.h
+ *  \brief Run-length encoded binary masks.
+ *
+ *  Threshold masks for retroreflective tape are mostly empty, with a few long horizontal runs.
+ *  An rle_mask stores only the runs of set pixels (plus one index entry per row), so the storage
+ *  and the cost of morphology and labeling scale with the amount of target in the frame rather
+ *  than with the frame size.
+ */
+
+/*! \struct rle_run
+ *  \brief A horizontal run of set pixels: (x0 .. x1-1, y).
+ */
+struct rle_run {
+	int y;
+	int x0;		//!< First set pixel.
+	int x1;		//!< One past the last set pixel.
+};
+
+/*! \class rle_mask
+ *  \brief Binary mask stored as maximal runs, sorted by row and then by column.
+ *
+ *  Masks are built a row at a time, top to bottom: reset(), then appendRow() (or one of the
+ *  producers that call it) once for every row. Storage is reused across frames.
+ */
+class rle_mask {
+public:
+	void reset(cv::Size sz);
+	void appendRow(int y, const unsigned char* row);
+	void appendRun(int y, int x0, int x1);
+	void endRow(int y);
+
+	void fromMat(const cv::Mat& mask);
+	void toMat(cv::Mat& out) const;
+
+	void erode(rle_mask& dst, cv::Size ksize) const;
+	void dilate(rle_mask& dst, cv::Size ksize) const;
+
+	cv::Size size() const { return sz; };
+	size_t area() const;
+	const std::vector<rle_run>& runs() const { return runList; };
+
+	/*! \fn rowBegin(int y)
+	 *  \brief First run of row y; rows are laid out contiguously, so row y's runs are [rowBegin(y), rowBegin(y+1)).
+	 */
+	const rle_run* rowBegin(int y) const { return runList.data() + rowStart[y]; };
+	const rle_run* rowEnd(int y) const { return runList.data() + rowStart[y+1]; };
+
+	/*! \fn rowBuffer()
+	 *  \brief A scratch row of size().width bytes, for producers that classify a row before encoding it.
+	 */
+	unsigned char* rowBuffer() { return scratch.data(); };
+
+private:
+	void morph(rle_mask& dst, cv::Size ksize, bool dilation) const;
+
+	cv::Size sz;
+	std::vector<rle_run> runList;
+	std::vector<int> rowStart;		//!< Index of each row's first run; size().height+1 entries.
+	std::vector<unsigned char> scratch;
+
+	/* Scratch used when this mask is the destination of erode() or dilate(): */
+	std::vector<rle_run> hpass;		//!< Source runs after the horizontal pass.
+	std::vector<int> hpassStart;
+	std::vector<rle_run> accumA;
+	std::vector<rle_run> accumB;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include <vector>
+#include <string>
+#include <ostream>
+#include <atomic>
+#include <stdint.h>
+
+/*! \file score_cascade.h
+ *  \brief Ordered, early-exit candidate scoring with per-test rejection counts.
+ *
+ *  A target's score is the mean of several tests, each scoring 0-100. The tests are run one at a
+ *  time in a configurable order, and as soon as a candidate could no longer reach minScore even if
+ *  every remaining test scored 100, it is rejected without running the rest. Candidates that pass the
+ *  area test are measured once up front (see contour_descriptor.h), so the order only decides which
+ *  tests' arithmetic is skipped.
+ *
+ *  Every rejection is counted against the test that caused it, so the order can be tuned to put the
+ *  most selective tests first for the conditions at hand.
+ */
+
+/*! \struct candidate_geometry
+ *  \brief Measurements of one candidate, as seen by the scoring tests.
+ */
+struct candidate_geometry {
+	double area;
+	cv::Rect bounds;
+	const cv::Mat* mask = NULL;	//!< Binary mask the candidate was found in, if the engine has one (see image_profile.h).
+	cv::Point maskOffset;		//!< Frame coordinates of the mask's top left pixel.
+
+	candidate_geometry(double a, const cv::Rect& b, const cv::Moments& moments) : area(a), bounds(b), m(&moments) {};
+	candidate_geometry(double a, const cv::Rect& b, const cv::Moments& moments, const cv::Mat* mk, cv::Point offset) :
+		area(a), bounds(b), mask(mk), maskOffset(offset), m(&moments) {};
+
+	const cv::Moments& moments() const { return *m; };
+
+private:
+	const cv::Moments* m;
+};
+
+/*! \class score_cascade
+ *  \brief Test order, rejection policy and statistics for one target's scoring tests.
+ *
+ *  Test 0 is always the minimum area test. It runs first: contours too short to enclose the minimum area
+ *  are rejected from their point count alone, and the rest are measured in one pass before it is applied.
+ *  Optional tests can be disabled, which drops them from the order and from the mean score.
+ *  Counters may be updated from several scoring threads at once.
+ */
+class score_cascade {
+public:
+	static const int maxTests = 8;
+
+	score_cascade(const char* const* testNames, int nTests, unsigned int disabledTests=0);
+
+	double minScore = 0;	//!< Candidates whose mean score can't reach this are rejected. 0 accepts everything past the area test.
+
+	bool setOrder(const std::string& list);
+	std::string getOrder() const;
+
+	bool setEnabled(const std::string& name, bool enable);
+	bool isEnabled(int t) const;
+
+	/*! \fn test(int i)
+	 *  \brief The i-th scoring test to run (1 .. count()-1).
+	 */
+	int test(int i) const { return order[i]; };
+	int count() const { return nActive; };		//!< Number of enabled tests, including the area test.
+	const char* testName(int t) const { return names[t]; };
+
+	/*! \fn bail(double sum, int done)
+	 *  \brief Whether a candidate whose first done scoring tests add up to sum can no longer reach minScore.
+	 */
+	bool bail(double sum, int done) const {
+		return ((sum + (100.0 * ((nActive - 1) - done))) / (nActive - 1)) < minScore;
+	};
+
+	void countCandidate() { candidates.fetch_add(1, std::memory_order_relaxed); };
+	void reject(int test) { rejected[test].fetch_add(1, std::memory_order_relaxed); };
+
+	void report(std::ostream& out) const;
+	void resetCounts();
+
+private:
+	const char* const* names;
+	int nTests;
+	int nActive;		//!< Enabled tests, which are order[0 .. nActive-1].
+	int order[maxTests];
+
+	std::atomic<uint32_t> candidates;
+	std::atomic<uint32_t> rejected[maxTests];
+};
+
+/*! \enum goal_score_test
+ *  \brief Tests in goal_cascade.
+ */
+enum goal_score_test {
+	GOAL_TEST_AREA,		//!< Minimum area.
+	GOAL_TEST_COVERAGE,	//!< Contour area vs. bounding box area.
+	GOAL_TEST_ASPECT,	//!< Bounding box aspect ratio.
+	GOAL_TEST_PROFILE,	//!< U-shaped column height profile (needs the mask; disabled by default, see image_profile.h).
+	GOAL_TEST_MOMENT,	//!< Normalized central moment nu02 (needs moments).
+	GOAL_TEST_ANGLE,	//!< Orientation (needs moments).
+	GOAL_TEST_COUNT
+};
+
+/*! \enum boulder_score_test
+ *  \brief Tests in boulder_cascade.
+ */
+enum boulder_score_test {
+	BOULDER_TEST_AREA,		//!< Minimum area.
+	BOULDER_TEST_CIRCULARITY,	//!< Area vs. the circle inscribed in the bounding box.
+	BOULDER_TEST_ASPECT,		//!< Bounding box aspect ratio.
+	BOULDER_TEST_COUNT
+};
+
+extern score_cascade goal_cascade;
+extern score_cascade boulder_cascade;
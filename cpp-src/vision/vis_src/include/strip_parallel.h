@@ -0,0 +1,27 @@
+#pragma once
+#include "opencv2/core.hpp"
+#include <vector>
+
+/*! \file strip_parallel.h
+ *  \brief Runs a preprocessing stage chain on horizontal bands of a frame in parallel.
+ */
+
+/*! \struct strip_buffers
+ *  \brief Private intermediate buffers for one band.
+ */
+struct strip_buffers {
+	cv::Mat hsv;
+	cv::Mat mask;
+	cv::Mat morph;
+	cv::Mat blurred;
+};
+
+/*! \typedef mask_chain_fn
+ *  \brief A chain of local image operations that turns a BGR frame into a 1-channel mask (written to blurred).
+ *
+ *  Every stage must only look at a bounded neighborhood of each pixel, so that the result for a band can be
+ *  computed from that band plus a fixed number of halo rows above and below it.
+ */
+typedef void (*mask_chain_fn)(cv::Mat input, cv::Mat& hsv, cv::Mat& mask, cv::Mat& morph, cv::Mat& blurred, const cv::Mat& kernel, bool live_output);
+
+extern void stripParallelChain(cv::Mat input, cv::Mat& output, mask_chain_fn chain, const cv::Mat& kernel, int halo, int nStrips, std::vector<strip_buffers>& strips);
@@ -0,0 +1,534 @@
+#pragma once
+#include "visproc_common.h"
+#include "score_cascade.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include <vector>
+#include <iostream>
+#include <climits>
+#include <algorithm>
+
+/*! \file target_pipeline.h
+ *  \brief Preprocessing and candidate scoring shared by every target type, specialized at compile time.
+ *
+ *  The goal and boulder pipelines run the same chain (threshold, morphology, blur, Canny, then contour
+ *  or blob scoring) with different constants. Each target type supplies those as a policy struct,
+ *  and the templates below are instantiated once per target, so kernel sizes fold to constants and
+ *  the scoring function is inlined into the candidate loop. A policy looks like:
+ *
+ *  \code
+ *  struct peg_target {
+ *  	static const int morphOp = cv::MORPH_ERODE;		// MORPH_ERODE or MORPH_DILATE
+ *  	static const int morphSize = 5;				// Square morphology kernel size
+ *  	static const int blurSize = 3;				// Box blur before Canny
+ *  	static const int hsvBlurSize = 5;			// Gaussian on the HSV image (THRES_LEGACY only)
+ *  	static constexpr double hsvBlurSigma = 2.5;
+ *  	static const int hsvBlurBorder = cv::BORDER_REPLICATE;
+ *  	static constexpr double minArea = 1000;			// Candidates smaller than this are not scored
+ *
+ *  	static hsv_range range();				// Current color threshold
+ *  	static hsv_color_lut& colorLUT();			// Table used with THRES_LUT
+ *  	static score_cascade& cascade();			// Scoring test order and statistics
+ *  	static double test(int t, const candidate_geometry& c, bool suppress_output);	// Score (0-100) for cascade test t >= 1
+ *  };
+ *  \endcode
+ *
+ *  Only the way results are reported (best candidate vs. every candidate, ROI tracking) is left to
+ *  each target's own pipeline functions.
+ */
+
+/* Rows of context target_mask_chain needs around each strip: Gaussian + morphology + blur. */
+template<class Target>
+constexpr int target_stripHalo() {
+	return (Target::hsvBlurSize / 2) + (Target::morphSize / 2) + (Target::blurSize / 2);
+}
+
+template<class Target>
+inline cv::Size target_morphSize() {
+	return cv::Size(Target::morphSize, Target::morphSize);
+}
+
+/* Bring the target's color table up to date with its range, if THRES_LUT is selected. This is the frame
+ * boundary for the table: call it once per frame, before any thresholding, so that every strip and window
+ * of the frame is classified with the same table (see hsv_color_lut). */
+template<class Target>
+inline void target_update_lut() {
+	if(visproc_thresholdMode == THRES_LUT) {
+		Target::colorLUT().update(Target::range());
+	}
+}
+
+/* Color-threshold a frame (or window) into mask, using the selected threshold_mode.
+ * With THRES_LUT, the table is only read: target_update_lut() must have been called for the frame. */
+template<class Target>
+void target_threshold(cv::Mat input, cv::Mat& hsv, cv::Mat& mask, bool live_output) {
+	VISPROC_PROFILE(PROF_THRESHOLD);
+
+	hsv_range range = Target::range();
+
+	if(visproc_thresholdMode == THRES_LEGACY) {
+		{
+			VISPROC_PROFILE(PROF_HSV);
+			cv::cvtColor(input, hsv, CV_BGR2HSV);
+
+			/* Make things easier for the HSV filter */
+			cv::GaussianBlur(hsv, hsv, cv::Size(Target::hsvBlurSize, Target::hsvBlurSize), Target::hsvBlurSigma, Target::hsvBlurSigma, Target::hsvBlurBorder);
+		}
+		drawOut("stage1", hsv, live_output);
+
+		cv::inRange(hsv, cv::Scalar(range.min[0], range.min[1], range.min[2]), cv::Scalar(range.max[0], range.max[1], range.max[2]), mask);
+	} else if(visproc_thresholdMode == THRES_LUT) {
+		/* Convert and filter in one pass */
+		Target::colorLUT().apply(input, mask);
+	} else {
+		fusedHSVThreshold(input, mask, range, visproc_thresholdMode);
+	}
+}
+
+template<class Target>
+inline void target_morph(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kernel) {
+	VISPROC_PROFILE(PROF_MORPH);
+	if(Target::morphOp == cv::MORPH_ERODE) {
+		cv::erode(src, dst, kernel);
+	} else {
+		cv::dilate(src, dst, kernel);
+	}
+}
+
+/* The stages after the color threshold: erode / dilate, blur.
+ * The blob engine works on the binary mask, so with ENGINE_BLOBS the morphology is written straight to blurred. */
+template<class Target>
+void target_mask_post(const cv::Mat& mask, cv::Mat& morph, cv::Mat& blurred, const cv::Mat& kernel, bool live_output) {
+	if(visproc_detectEngine == ENGINE_BLOBS) {
+		target_morph<Target>(mask, blurred, kernel);
+		drawOut("stage3", blurred, live_output);
+		return;
+	}
+
+	/* Remove smaller hits */
+	target_morph<Target>(mask, morph, kernel);
+	drawOut("stage3", morph, live_output);
+
+	/* Blur for edge detection */
+	{
+		VISPROC_PROFILE(PROF_BLUR);
+		cv::blur(morph, blurred, cv::Size(Target::blurSize, Target::blurSize));
+	}
+	drawOut("stage4", blurred, live_output);
+}
+
+/* Every preprocessing stage before Canny: threshold, erode / dilate, blur. Matches mask_chain_fn. */
+template<class Target>
+void target_mask_chain(cv::Mat input, cv::Mat& hsv, cv::Mat& mask, cv::Mat& morph, cv::Mat& blurred, const cv::Mat& kernel, bool live_output) {
+	target_threshold<Target>(input, hsv, mask, live_output);
+	drawOut("stage2", mask, live_output);
+
+	target_mask_post<Target>(mask, morph, blurred, kernel, live_output);
+}
+
+/* Erode / dilate ctx.rle into ctx.rleMorph. */
+template<class Target>
+void target_morph_rle(visproc_context& ctx, bool live_output) {
+	/* Only decode for the debugging windows */
+	if(live_output) {
+		ctx.rle.toMat(ctx.mask);
+		drawOut("stage2", ctx.mask, live_output);
+	}
+
+	{
+		VISPROC_PROFILE(PROF_MORPH);
+		if(Target::morphOp == cv::MORPH_ERODE) {
+			ctx.rle.erode(ctx.rleMorph, target_morphSize<Target>());
+		} else {
+			ctx.rle.dilate(ctx.rleMorph, target_morphSize<Target>());
+		}
+	}
+
+	if(live_output) {
+		ctx.rleMorph.toMat(ctx.morph);
+		drawOut("stage3", ctx.morph, live_output);
+	}
+}
+
+/* Canny's hysteresis step follows edges across the whole image, so it can't be split into strips. */
+inline cv::Mat& target_edges(visproc_context& ctx, bool live_output) {
+	{
+		VISPROC_PROFILE(PROF_CANNY);
+		cv::Canny(ctx.blurred, ctx.edges, cannyThresMin, cannyThresMin+cannyThresSize);
+	}
+	drawOut("stage5", ctx.edges, live_output);
+
+	return ctx.edges;
+}
+
+/* ENGINE_RLE preprocessing: threshold straight into runs, then erode / dilate the runs. The result is left in ctx.rleMorph. */
+template<class Target>
+void target_preprocess_rle(cv::Mat input, visproc_context& ctx, bool live_output) {
+	if(visproc_thresholdMode == THRES_LEGACY) {
+		/* The legacy chain blurs in HSV, so it has to go through a full mask */
+		target_threshold<Target>(input, ctx.hsv, ctx.mask, live_output);
+		ctx.rle.fromMat(ctx.mask);
+	} else if(visproc_thresholdMode == THRES_LUT) {
+		Target::colorLUT().apply(input, ctx.rle);
+	} else {
+		fusedHSVThreshold(input, ctx.rle, Target::range(), visproc_thresholdMode);
+	}
+
+	target_morph_rle<Target>(ctx, live_output);
+}
+
+/*!	\fn target_preprocess_window(cv::Mat input, visproc_context& ctx, bool live_output)
+ *	\brief Run the full preprocessing chain for a target on a frame or a window of one.
+ *
+ *	\return ctx.edges, or the morphology output in ctx.blurred with ENGINE_BLOBS. With ENGINE_RLE
+ *	the result is left in ctx.rleMorph, and the returned Mat is empty. If ctx.preprocess is set,
+ *	that pipeline is run instead, and its output is returned.
+ *	With THRES_LUT, the caller must have called target_update_lut() for the frame.
+ */
+template<class Target>
+cv::Mat& target_preprocess_window(cv::Mat input, visproc_context& ctx, bool live_output) {
+	VISPROC_PROFILE(PROF_PREPROCESS);
+
+	if(ctx.preprocess != NULL) {
+		cv::Mat& out = ctx.preprocess->run(input, live_output);
+		if(visproc_detectEngine == ENGINE_RLE) {
+			ctx.rleMorph.fromMat(out);
+		}
+		return out;
+	}
+
+	if(visproc_detectEngine == ENGINE_RLE) {
+		target_preprocess_rle<Target>(input, ctx, live_output);
+
+		ctx.blurred.release();
+		return ctx.blurred;
+	}
+
+	const cv::Mat& kernel = ctx.getMorphKernel(target_morphSize<Target>());
+
+	if((ctx.parallelStrips > 1) && !live_output) {
+		stripParallelChain(input, ctx.blurred, &target_mask_chain<Target>, kernel, target_stripHalo<Target>(), ctx.parallelStrips, ctx.strips);
+	} else {
+		target_mask_chain<Target>(input, ctx.hsv, ctx.mask, ctx.morph, ctx.blurred, kernel, live_output);
+	}
+
+	if(visproc_detectEngine == ENGINE_BLOBS) {
+		return ctx.blurred;
+	}
+
+	return target_edges(ctx, live_output);
+}
+
+/*!	\fn target_process_mask(visproc_context& ctx, bool live_output)
+ *	\brief Run the preprocessing stages that follow the color threshold on a mask already in ctx.mask.
+ *
+ *	Used when the threshold was computed elsewhere (see multi_target.h). Returns the same buffers as
+ *	target_preprocess_window(); the mask always covers the whole frame.
+ */
+template<class Target>
+cv::Mat& target_process_mask(visproc_context& ctx, bool live_output) {
+	if(visproc_detectEngine == ENGINE_RLE) {
+		ctx.rle.fromMat(ctx.mask);
+		target_morph_rle<Target>(ctx, live_output);
+
+		ctx.blurred.release();
+		return ctx.blurred;
+	}
+
+	target_mask_post<Target>(ctx.mask, ctx.morph, ctx.blurred, ctx.getMorphKernel(target_morphSize<Target>()), live_output);
+
+	if(visproc_detectEngine == ENGINE_BLOBS) {
+		return ctx.blurred;
+	}
+
+	return target_edges(ctx, live_output);
+}
+
+/*!	\fn target_cascade(const candidate_geometry& c, bool suppress_output)
+ *	\brief Run a candidate that passed the area test through the rest of the target's score_cascade.
+ *	\return The mean of the test scores, or -1 if the candidate was rejected. A cascade with no tests but
+ *	the area test (which score_cascade::setEnabled() doesn't allow, but a target may declare) scores 100.
+ */
+template<class Target>
+double target_cascade(const candidate_geometry& c, bool suppress_output) {
+	score_cascade& cascade = Target::cascade();
+	const int nScored = cascade.count() - 1;
+	if(nScored <= 0) {
+		return 100;
+	}
+
+	double sum = 0;
+	for(int i=1;i<=nScored;i++) {
+		int t = cascade.test(i);
+		sum += Target::test(t, c, suppress_output);
+
+		if(cascade.bail(sum, i)) {
+			if(!suppress_output) { std::cout << "Rejected by " << cascade.testName(t) << " test" << std::endl; }
+			cascade.reject(t);
+			return -1;
+		}
+	}
+
+	double total_score = sum / nScored;
+	if(!suppress_output) { std::cout << "Total Score: " << total_score << std::endl; }
+
+	return total_score;
+}
+
+/* The binary mask behind a preprocessed input, for tests that look at a candidate's pixels; NULL if there is none
+ * (with a custom ctx.preprocess pipeline, or ENGINE_RLE). */
+inline const cv::Mat* target_score_mask(const visproc_context& ctx, const cv::Mat& input) {
+	if((ctx.preprocess != NULL) || ctx.blurred.empty() || (ctx.blurred.size() != input.size())) {
+		return NULL;
+	}
+	return &ctx.blurred;
+}
+
+/* Score contour i of arena through the area test and the rest of the cascade; returns -1 if it was rejected.
+ * The contour is measured once, into d, which the winner's contour_record is later made from; contours whose
+ * point count alone rules out minArea are rejected without reading their points (d is then left empty).
+ * mask (if not NULL) is the mask it was traced from, whose top left pixel is at offset in the frame.
+ * ctr numbers the contours that pass the area test in the debugging output. */
+template<class Target>
+double target_score_contour(const contour_arena& arena, size_t i, contour_descriptor& d, const cv::Mat* mask, cv::Point offset, unsigned int& ctr, bool suppress_output) {
+	score_cascade& cascade = Target::cascade();
+	cascade.countCandidate();
+
+	/* Area Thresholding Test: only accept contours of a certain total size. */
+	if(arena.maxArea(i) < Target::minArea) {
+		d = contour_descriptor();
+		cascade.reject(0);
+		return -1;
+	}
+
+	describeContour(arena.contour(i), d);
+	if(d.area < Target::minArea) {
+		cascade.reject(0);
+		return -1;
+	}
+
+	if(!suppress_output) {
+		std::cout << std::endl;
+		std::cout << "Contour " << ctr << ": " << std::endl;
+		ctr++;
+		std::cout << "Area: "  << d.area << std::endl;
+		std::cout << "Perimeter: " << d.perimeter << std::endl;
+	}
+
+	return target_cascade<Target>(candidate_geometry(d.area, d.bounds, d.moments, mask, offset), suppress_output);
+}
+
+/* Scores contiguous chunks of the arena's contours from first on OpenCV's thread pool, each into its own
+ * buffer in ctx.scoreChunks. Each buffer keeps only its chunk's best topK (all if 0); the best topK overall
+ * are always among them. */
+template<class Target>
+class target_score_chunk_body : public cv::ParallelLoopBody {
+public:
+	target_score_chunk_body(visproc_context& c, size_t f, int n, size_t k, const cv::Mat* m, cv::Point o) :
+		ctx(c), first(f), nChunks(n), topK(k), mask(m), offset(o) {};
+
+	void operator()(const cv::Range& range) const {
+		const size_t nContours = ctx.arena.size() - first;
+		for(int c=range.start;c<range.end;c++) {
+			size_t i0 = first + ((nContours * c) / nChunks);
+			size_t i1 = first + ((nContours * (c+1)) / nChunks);
+
+			std::vector<scoredIndex>& buf = ctx.scoreChunks[c];
+			buf.clear();
+
+			unsigned int ctr = 0;
+			for(size_t i=i0;i<i1;i++) {
+				double score = target_score_contour<Target>(ctx.arena, i, ctx.descriptors[i], mask, offset, ctr, true);
+				if(score >= 0) {
+					buf.push_back(std::make_pair(score, i));
+				}
+			}
+
+			if(topK > 0) {
+				selectTopScores(buf, topK);
+			}
+		}
+	}
+
+private:
+	visproc_context& ctx;
+	size_t first;
+	int nChunks;
+	size_t topK;
+	const cv::Mat* mask;
+	cv::Point offset;
+};
+
+/* Find and score the contours in a preprocessed frame or window, adding them to ctx.arena and filling ctx.scores
+ * with their indices there. offset maps the window back into frame coordinates.
+ * Frames with at least ctx.parallelScoreContours contours are scored in parallel (only without debugging output,
+ * which would interleave); ctx.scores then holds each chunk's best topK, which always include the best topK that
+ * the serial loop would have found. */
+template<class Target>
+void target_score_contours(cv::Mat input, cv::Point offset, visproc_context& ctx, bool suppress_output, bool window_output, size_t topK) {
+	contour_arena& arena = ctx.arena;
+	const size_t first = arena.size();
+	{
+		VISPROC_PROFILE(PROF_CONTOURS);
+		arena.extractBounded(input, ctx.contourWork, offset, ctx.contourLimits);
+	}
+	const size_t nContours = arena.size() - first;
+	ctx.descriptors.resize(arena.size());
+	ctx.scores.clear();
+	ctx.frameDegraded = ctx.frameDegraded || arena.degraded();
+
+	if(!suppress_output) {
+		std::cout << "Found " << nContours << " contours." << std::endl;
+		if(ctx.frameDegraded) { std::cout << "Contour limits exceeded; frame degraded." << std::endl; }
+	}
+
+	if(window_output) {
+		cv::Mat conOut = cv::Mat::zeros(input.size(), CV_8UC3);
+		std::vector<cv::Mat> one(1);
+		for(size_t i=first;i<arena.size();i++) {
+			cv::Scalar col(rand()&180, rand()&255, rand()&255);
+			one[0] = arena.contour(i);
+			cv::drawContours(conOut, one, 0, col, CV_FILLED, 8, cv::Mat(), INT_MAX, -offset);
+		}
+		drawOut("contours", conOut, window_output);
+	}
+
+	VISPROC_PROFILE(PROF_SCORING);
+	const cv::Mat* mask = target_score_mask(ctx, input);
+	const int nThreads = cv::getNumThreads();
+	if(suppress_output && (ctx.parallelScoreContours > 0) && (nContours >= ctx.parallelScoreContours) && (nThreads > 1)) {
+		VISPROC_PROFILE(PROF_SCORING_PARALLEL);
+		if(ctx.scoreChunks.size() < (size_t)nThreads) {
+			ctx.scoreChunks.resize(nThreads);
+		}
+
+		cv::parallel_for_(cv::Range(0, nThreads), target_score_chunk_body<Target>(ctx, first, nThreads, topK, mask, offset), nThreads);
+
+		/* Merge in chunk order, so the candidates stay in index order as with the serial loop */
+		for(int c=0;c<nThreads;c++) {
+			ctx.scores.insert(ctx.scores.end(), ctx.scoreChunks[c].begin(), ctx.scoreChunks[c].end());
+		}
+		return;
+	}
+
+	unsigned int ctr = 0;
+	for(size_t i=first;i<arena.size();i++) {
+		double score = target_score_contour<Target>(arena, i, ctx.descriptors[i], mask, offset, ctr, suppress_output);
+		if(score >= 0) {
+			ctx.scores.push_back(std::make_pair(score, i));
+		}
+	}
+}
+
+/* Label and score the blobs in a preprocessed (binary) frame or window; with ENGINE_RLE, in ctx.rleMorph instead.
+ * Fills ctx.scores with indices into ctx.blobs.blobs(). */
+template<class Target>
+void target_score_blobs(cv::Mat input, cv::Point offset, visproc_context& ctx, bool suppress_output, bool window_output) {
+	cv::Size sz = input.size();
+	{
+		VISPROC_PROFILE(PROF_CONTOURS);
+		if(visproc_detectEngine == ENGINE_RLE) {
+			sz = ctx.rleMorph.size();
+			ctx.blobs.label(ctx.rleMorph, offset);
+		} else {
+			ctx.blobs.label(input, offset);
+		}
+	}
+	const std::vector<blob_features>& blobs = ctx.blobs.blobs();
+	ctx.scores.clear();
+
+	/* Labeling is a single pass, so only the scoring work needs a cap: keep the largest maxContours blobs,
+	 * in label order. */
+	ctx.blobOrder.resize(blobs.size());
+	for(size_t i=0;i<blobs.size();i++) {
+		ctx.blobOrder[i] = i;
+	}
+	const size_t maxBlobs = ctx.contourLimits.maxContours;
+	if((maxBlobs > 0) && (blobs.size() > maxBlobs)) {
+		ctx.frameDegraded = true;
+		std::nth_element(ctx.blobOrder.begin(), ctx.blobOrder.begin() + maxBlobs, ctx.blobOrder.end(),
+			[&blobs](size_t a, size_t b) { return (blobs[a].area > blobs[b].area) || ((blobs[a].area == blobs[b].area) && (a < b)); });
+		ctx.blobOrder.resize(maxBlobs);
+		std::sort(ctx.blobOrder.begin(), ctx.blobOrder.end());
+	}
+
+	if(!suppress_output) {
+		std::cout << "Found " << blobs.size() << " blobs." << std::endl;
+		if(ctx.frameDegraded) { std::cout << "Blob limit exceeded; frame degraded." << std::endl; }
+	}
+
+	if(window_output) {
+		cv::Mat conOut = cv::Mat::zeros(sz, CV_8UC3);
+		for(size_t i=0;i<blobs.size();i++) {
+			cv::Scalar col(rand()&180, rand()&255, rand()&255);
+			cv::rectangle(conOut, blobs[i].bounds - offset, col, CV_FILLED);
+		}
+		drawOut("contours", conOut, window_output);
+	}
+
+	VISPROC_PROFILE(PROF_SCORING);
+	const cv::Mat* mask = target_score_mask(ctx, input);
+	score_cascade& cascade = Target::cascade();
+	unsigned int ctr = 0;
+	for(size_t k=0;k<ctx.blobOrder.size();k++) {
+		const size_t i = ctx.blobOrder[k];
+		cascade.countCandidate();
+		if(blobs[i].area < Target::minArea) {
+			cascade.reject(0);
+			continue;
+		}
+
+		if(!suppress_output) {
+			std::cout << std::endl;
+			std::cout << "Blob " << ctr << ": " << std::endl;
+			ctr++;
+			std::cout << "Area: "  << blobs[i].area << std::endl;
+		}
+
+		double score = target_cascade<Target>(candidate_geometry(blobs[i].area, blobs[i].bounds, blobs[i].moments, mask, offset), suppress_output);
+		if(score >= 0) {
+			ctx.scores.push_back(std::make_pair(score, i));
+		}
+	}
+}
+
+/*!	\fn target_score(cv::Mat input, cv::Point offset, visproc_context& ctx, bool suppress_output, bool window_output, size_t topK)
+ *	\brief Find and score candidates with the selected detect_engine, filling ctx.scores (unsorted).
+ *
+ *	topK is the number of best candidates the caller will select from ctx.scores (0 for all); other candidates
+ *	may be left out of it. The selected candidates are the same whether or not scoring ran in parallel.
+ *
+ *	Indices in ctx.scores refer to ctx.arena with ENGINE_CONTOURS, and to ctx.blobs.blobs() otherwise;
+ *	use target_record() to get a candidate's measurements and points either way.
+ *	Contours are added to ctx.arena, which the caller should clear() once per frame.
+ */
+template<class Target>
+void target_score(cv::Mat input, cv::Point offset, visproc_context& ctx, bool suppress_output, bool window_output, size_t topK) {
+	if(visproc_detectEngine != ENGINE_CONTOURS) {
+		target_score_blobs<Target>(input, offset, ctx, suppress_output, window_output);
+	} else {
+		target_score_contours<Target>(input, offset, ctx, suppress_output, window_output, topK);
+	}
+}
+
+/* Make the contour_record for a scored candidate from the measurements taken while scoring it. A blob's outline
+ * is added to ctx.arena so that it can be read back the same way as a contour's points; its perimeter is the
+ * outline's. */
+inline contour_record target_record(visproc_context& ctx, const scoredIndex& scored) {
+	if(visproc_detectEngine != ENGINE_CONTOURS) {
+		const blob_features& blob = ctx.blobs.blobs()[scored.second];
+		blob.outline(ctx.outlineWork);
+
+		contour_record r;
+		r.score = scored.first;
+		r.offset = ctx.arena.append(ctx.outlineWork);
+		r.length = ctx.outlineWork.size();
+		r.area = blob.area;
+		r.perimeter = cv::arcLength(ctx.outlineWork, true);
+		r.bounds = blob.bounds;
+		r.moments = blob.moments;
+		return r;
+	} else {
+		return ctx.arena.record(scored.second, scored.first, ctx.descriptors[scored.second]);
+	}
+}
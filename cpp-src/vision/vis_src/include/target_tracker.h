@@ -0,0 +1,116 @@
+#pragma once
+#include "opencv2/core.hpp"
+#include <vector>
+#include <stdint.h>
+
+/*! \file target_tracker.h
+ *  \brief Frame-to-frame association and smoothing of detections.
+ *
+ *  Every pipeline call judges its frame on its own, so reported distances and angles jitter with the
+ *  contour outline, and a missed frame looks like a lost target. A target_tracker matches each frame's
+ *  detections to the tracks from earlier frames, and runs a constant-velocity alpha-beta filter on each
+ *  track's bounding box, distance and angle. Between detector runs, tracks can be extrapolated to any
+ *  time, which gives both a search window for ROI processing and values to report for frames that were
+ *  not processed at all.
+ */
+
+/*! \struct alpha_beta_filter
+ *  \brief Constant-velocity alpha-beta filter for one scalar.
+ */
+struct alpha_beta_filter {
+	double x = 0;	//!< Estimated value.
+	double v = 0;	//!< Estimated rate of change, per second.
+
+	void reset(double x0) { x = x0; v = 0; };
+	double predict(double dt) const { return x + (v * dt); };
+	void update(double z, double dt, double alpha, double beta);
+};
+
+/*! \struct tracker_measurement
+ *  \brief One detection, as fed to target_tracker::update().
+ */
+struct tracker_measurement {
+	cv::Rect bounds;	//!< Bounding box, in frame coordinates.
+	double score;
+	double distance;	//!< Distance to the target, in whatever units the caller reports.
+	double angle;		//!< Angle to the target.
+};
+
+/*! \enum track_channel
+ *  \brief The quantities filtered for each track.
+ */
+enum track_channel {
+	TRACK_CX,		//!< Bounding box center.
+	TRACK_CY,
+	TRACK_W,		//!< Bounding box size.
+	TRACK_H,
+	TRACK_DISTANCE,
+	TRACK_ANGLE,
+	TRACK_CHANNELS
+};
+
+/*! \struct target_track
+ *  \brief One tracked target.
+ */
+struct target_track {
+	int id;					//!< Unique within a tracker, in order of creation.
+	alpha_beta_filter state[TRACK_CHANNELS];
+	double score;				//!< Score of the last associated detection.
+	unsigned int hits;			//!< Detections associated with this track.
+	unsigned int misses;			//!< Detector runs in a row without one.
+	int64_t ticks;				//!< cv::getTickCount() of the state estimate.
+
+	/*! \fn bounds(double dt)
+	 *  \brief Bounding box extrapolated dt seconds past the state estimate.
+	 */
+	cv::Rect bounds(double dt=0) const;
+	double distance(double dt=0) const { return state[TRACK_DISTANCE].predict(dt); };
+	double angle(double dt=0) const { return state[TRACK_ANGLE].predict(dt); };
+};
+
+/*! \class target_tracker
+ *  \brief Associates detections across frames and smooths them.
+ *
+ *  Each update() predicts every track to the new frame's time, then pairs tracks and detections greedily
+ *  by distance between predicted and detected centers (relative to the predicted box's size), closest
+ *  pairs first. Pairs further apart than gate are not matched. Matched tracks are corrected, unmatched
+ *  tracks coast on their prediction until they have missed maxMisses detector runs in a row, and every
+ *  unmatched detection starts a new track. Tracks count as confirmed once they have confirmHits detections.
+ *
+ *  alpha and beta trade smoothing against lag: with the defaults, a step change is mostly followed within
+ *  about 3 detections. Not thread-safe.
+ */
+class target_tracker {
+public:
+	double alpha = 0.5;		//!< Position gain.
+	double beta = 0.1;		//!< Velocity gain.
+	double gate = 1.0;		//!< Maximum center distance for a match, as a multiple of the predicted box's diagonal.
+	unsigned int confirmHits = 2;	//!< Detections before a track is reported by best().
+	unsigned int maxMisses = 5;	//!< Detector runs a track may go without a detection before it is dropped.
+
+	void update(const std::vector<tracker_measurement>& detections, int64_t ticks);
+	void reset();
+
+	const std::vector<target_track>& getTracks() const { return tracks; };
+	const target_track* best() const;
+
+	/*! \fn secondsSince(const target_track& t, int64_t ticks)
+	 *  \brief Time from a track's state estimate to ticks, for its prediction functions.
+	 */
+	double secondsSince(const target_track& t, int64_t ticks) const;
+
+	bool predict(int64_t ticks, cv::Rect& bounds, double& distance, double& angle, double& score) const;
+
+private:
+	struct pairing {
+		double cost;
+		size_t track;
+		size_t detection;
+	};
+
+	std::vector<target_track> tracks;
+	std::vector<pairing> pairs;
+	std::vector<bool> trackMatched;
+	std::vector<bool> detectionMatched;
+	int nextId = 0;
+};
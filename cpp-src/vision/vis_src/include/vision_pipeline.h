@@ -0,0 +1,134 @@
+#pragma once
+#include "hsv_threshold.h"
+#include "opencv2/core.hpp"
+#include <vector>
+#include <string>
+#include <ostream>
+
+/*! \file vision_pipeline.h
+ *  \brief Preprocessing stage chains built at runtime from a description file.
+ *
+ *  The built-in goal and boulder preprocessing chains have their stage order, kernel sizes and
+ *  Canny thresholds compiled in. A vision_pipeline instead reads them from an OpenCV FileStorage
+ *  (YAML or XML) file at startup, so stages can be dropped, reordered or retuned without rebuilding:
+ *
+ *  \code
+ *  %YAML:1.0
+ *  name: goal
+ *  stages:
+ *    - { type: hsv }
+ *    - { type: gaussian, ksize: [5, 5], sigma: 2.5, border: replicate }
+ *    - { type: threshold, target: goal }
+ *    - { type: erode, ksize: [5, 5] }
+ *    - { type: blur, ksize: [3, 3] }
+ *    - { type: canny, low: 10, high: 20 }
+ *  \endcode
+ *
+ *  Stage types:
+ *  - hsv: BGR to HSV conversion.
+ *  - gaussian: ksize, sigma (default 0: derived from ksize), border (default, replicate, reflect).
+ *  - threshold: target (goal or ball, using the live threshold globals), or min / max as [h, s, v].
+ *    On an HSV image this is cv::inRange; on a BGR image it is the fused or LUT kernel selected by
+ *    visproc_thresholdMode (THRES_LEGACY falls back to THRES_FUSED, as there is no HSV image to blur).
+ *  - erode, dilate: ksize (rectangular element).
+ *  - blur: ksize (box filter).
+ *  - canny: low, high.
+ *  Every stage also takes an optional name, used in timing reports and as its drawOut window.
+ *
+ *  Intermediate images live in a small pool of buffers owned by the pipeline: each stage writes to
+ *  a buffer of its output type other than the one it reads, so a chain needs at most two buffers
+ *  per image type, and none are reallocated between frames of the same size.
+ */
+
+/*! \enum pipeline_stage_type
+ *  \brief Operation performed by a pipeline_stage.
+ */
+enum pipeline_stage_type {
+	STAGE_HSV,
+	STAGE_GAUSSIAN,
+	STAGE_THRESHOLD,
+	STAGE_ERODE,
+	STAGE_DILATE,
+	STAGE_BLUR,
+	STAGE_CANNY
+};
+
+/*! \enum pipeline_format
+ *  \brief Kind of image passed between stages.
+ */
+enum pipeline_format {
+	FORMAT_BGR,	//!< 3-channel BGR (the input frame).
+	FORMAT_HSV,	//!< 3-channel HSV.
+	FORMAT_MASK	//!< 1-channel mask or grayscale.
+};
+
+/*! \enum threshold_target
+ *  \brief Which bounds a threshold stage uses.
+ */
+enum threshold_target {
+	TARGET_CUSTOM,	//!< pipeline_stage::range.
+	TARGET_GOAL,	//!< goal_hueThres / goal_valThres, and goal_colorLUT for THRES_LUT.
+	TARGET_BALL	//!< ball_hueThres / ball_satThres / ball_valThres, and ball_colorLUT for THRES_LUT.
+};
+
+/*! \struct pipeline_stage
+ *  \brief One stage of a vision_pipeline, with its parameters and timing.
+ */
+struct pipeline_stage {
+	pipeline_stage_type type;
+	std::string name;		//!< Label for timing reports and drawOut; defaults to the type name.
+
+	cv::Size ksize;			//!< Kernel size (gaussian, erode, dilate, blur).
+	double sigma = 0;		//!< Gaussian sigma.
+	int border;			//!< Gaussian border mode.
+	double cannyLow = 10;		//!< Canny lower threshold.
+	double cannyHigh = 20;		//!< Canny upper threshold.
+	int target = TARGET_CUSTOM;	//!< threshold_target of a threshold stage.
+	hsv_range range;		//!< Bounds of a TARGET_CUSTOM threshold stage.
+
+	cv::Mat kernel;			//!< Structuring element (erode, dilate); built by vision_pipeline::addStage.
+	pipeline_format inputFormat;	//!< Format of the image this stage reads; assigned by addStage.
+	int input = -1;			//!< Buffer read by this stage (-1 = the input frame); assigned by addStage.
+	int output = -1;		//!< Buffer written by this stage; assigned by addStage.
+
+	double lastMs = 0;		//!< Wall time of the last run.
+	double totalMs = 0;		//!< Wall time of all runs since the last resetTimings().
+	unsigned int runs = 0;		//!< Runs since the last resetTimings().
+
+	pipeline_stage(pipeline_stage_type t=STAGE_HSV);
+};
+
+/*! \class vision_pipeline
+ *  \brief An ordered chain of preprocessing stages with reusable buffers and per-stage timing.
+ *
+ *  Like visproc_context, a pipeline is not thread-safe; use one per processing thread.
+ */
+class vision_pipeline {
+public:
+	bool load(const std::string& path);
+	bool addStage(const pipeline_stage& stage);
+	void clear();
+
+	cv::Mat& run(cv::Mat input, bool live_output=false);
+
+	void printTimings(std::ostream& out) const;
+	void resetTimings();
+
+	bool empty() const { return stages.empty(); };
+	const std::string& getName() const { return name; };
+	const std::vector<pipeline_stage>& getStages() const { return stages; };
+	pipeline_format getOutputFormat() const { return format; };
+
+private:
+	int getBuffer(int type, int notThis);
+
+	std::string name;
+	std::vector<pipeline_stage> stages;
+	pipeline_format format = FORMAT_BGR;	//!< Format of the last stage's output.
+
+	std::vector<cv::Mat> buffers;
+	std::vector<int> bufferTypes;		//!< OpenCV type of each buffer.
+	cv::Mat passthrough;			//!< Returned by run() when there are no stages.
+};
+
+extern const char* pipelineStageName(pipeline_stage_type type);
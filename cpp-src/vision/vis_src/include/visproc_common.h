@@ -1,5 +1,11 @@
 #pragma once
 #include "visproc_interface.h"
+#include "visproc_context.h"
+#include "hsv_threshold.h"
+#include "color_lut.h"
+#include "blob_labeler.h"
+#include "visproc_profiler.h"
+#include "camera_model.h"
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
 
@@ -8,9 +14,12 @@
 #endif
 
 extern bool scoresort(scoredContour c1, scoredContour c2);
+extern bool indexscoresort(const scoredIndex& c1, const scoredIndex& c2);
+extern size_t selectTopScores(std::vector<scoredIndex>& scores, size_t k);
 extern double scoreDistanceFromTarget(const double target, double value);
 
 extern std::pair<double, double> getRelativeAngleOffCenter(scoredContour object, cv::Size fovSize, double distance);
+extern std::pair<double, double> getRelativeAngleOffCenter(const contour_record& object, cv::Size fovSize, double distance);
 extern double getAngleOffCenterline(cv::Size targetSz);
 
 #ifdef VISPROC_EXTENDED_TESTING
@@ -32,3 +41,6 @@ extern int goal_valThres[2];
 extern int ball_hueThres[2];
 extern int ball_satThres[2];
 extern int ball_valThres[2];
+
+extern hsv_color_lut goal_colorLUT;
+extern hsv_color_lut ball_colorLUT;
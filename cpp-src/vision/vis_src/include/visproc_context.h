@@ -0,0 +1,111 @@
+#pragma once
+#include "visproc_interface.h"
+#include "strip_parallel.h"
+#include "blob_labeler.h"
+#include "vision_pipeline.h"
+#include "change_detector.h"
+#include "contour_arena.h"
+#include "target_tracker.h"
+#include "opencv2/core.hpp"
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+/*! \file visproc_context.h
+ *  \brief Reusable per-stream state for the vision pipelines.
+ */
+
+typedef std::pair<double, size_t> scoredIndex; //!< Score and index into visproc_context::arena (or the blob list).
+
+/*! \struct visproc_context
+ *  \brief Owns every intermediate buffer and contour store used by the pipelines.
+ *
+ *  Buffers are sized on first use and reused afterwards, so a long-running caller that keeps
+ *  one context per camera does not reallocate any of them per frame once frame size and
+ *  contour counts settle. (OpenCV still uses its own internal scratch inside the filter,
+ *  Canny and findContours implementations.)
+ *
+ *  A context is not thread-safe; use one per processing thread.
+ */
+struct visproc_context {
+	cv::Mat hsv;			//!< HSV conversion of the input frame (THRES_LEGACY only).
+	cv::Mat mask;			//!< Color threshold mask.
+	cv::Mat morph;			//!< Mask after erosion / dilation.
+	cv::Mat blurred;		//!< Morphology output blurred for edge detection (unblurred with ENGINE_BLOBS).
+	cv::Mat edges;			//!< Canny output; the result of the preprocess pipelines.
+	cv::Mat contourWork;		//!< Scratch copy for findContours, which modifies its input.
+	rle_mask rle;			//!< Color threshold mask (ENGINE_RLE).
+	rle_mask rleMorph;		//!< Mask after erosion / dilation (ENGINE_RLE).
+
+	vision_pipeline* preprocess = NULL;	//!< If set, replaces the built-in preprocessing chain (see vision_pipeline.h).
+	int parallelStrips = 0;			//!< If > 1, split preprocessing into this many bands run in parallel.
+	std::vector<strip_buffers> strips;	//!< Per-band buffers for strip-parallel preprocessing.
+
+	cv::Mat morphKernel;		//!< Cached structuring element.
+	cv::Size morphKernelSize;	//!< Size morphKernel was created for.
+
+	contour_arena arena;				//!< Contours found in the current frame, and the points of its detections.
+	contour_limits contourLimits;			//!< Caps on candidate extraction (see contour_limits).
+	bool frameDegraded = false;			//!< Whether a contourLimits cap took effect in the current frame, with any engine.
+	std::vector<contour_descriptor> descriptors;	//!< Measurements of each contour in arena, indexed alike (filled while scoring).
+	std::vector<cv::Point> outlineWork;		//!< Scratch blob outline.
+	std::vector<scoredIndex> scores;		//!< Scores of accepted contours (or blobs).
+	size_t parallelScoreContours = 200;		//!< Score contours in parallel when a frame has at least this many; 0 disables.
+	std::vector< std::vector<scoredIndex> > scoreChunks;	//!< Per-chunk scores for parallel scoring.
+	blob_labeler blobs;				//!< Blobs found in the current frame (ENGINE_BLOBS).
+	std::vector<size_t> blobOrder;			//!< Scratch: indices of the blobs kept under contourLimits.maxContours.
+
+	std::vector<contour_record> detections;	//!< Winners of the last goal_pipeline or boulder_pipeline call, best first; points are in arena.
+	scoredContour best;			//!< goal_pipeline result, copied out of detections.
+	std::vector<scoredContour> results;	//!< boulder_pipeline results, best first, copied out of detections.
+	size_t maxResults = 0;			//!< Maximum number of boulder_pipeline results; 0 keeps every candidate.
+
+	/* ROI tracking (goal pipeline only): */
+	bool roiTracking = false;		//!< If true, only search a window around the last detection.
+	double roiExpand = 1.0;			//!< Window margin on each side, as a multiple of the last detection's size.
+	int roiMinMargin = 16;			//!< Minimum window margin on each side, in pixels.
+	unsigned int roiMaxMisses = 3;		//!< Consecutive misses before falling back to a full-frame search.
+
+	cv::Size frameSize;			//!< Size of the last frame passed to beginFrame().
+	cv::Rect roi;				//!< Region of the current frame being processed, in frame coordinates.
+	cv::Rect lastBounds;			//!< Bounding box of the last detection.
+	unsigned int missCount = 0;		//!< Frames since the last detection.
+	const target_tracker* tracker = NULL;	//!< If set, the window follows the tracker's prediction instead of the last detection.
+
+	/* Static-scene frame skipping (goal pipeline only): */
+	bool skipStaticFrames = false;		//!< If true, frames that barely differ from the last processed one reuse its result.
+	frame_change_detector changes;		//!< Decides which frames are unchanged (see change_detector.h for its settings).
+	bool frameReused = false;		//!< Whether the current frame was skipped and its result carried over.
+	int64_t resultTicks = 0;		//!< cv::getTickCount() when best was last computed, or confirmed by an unchanged frame.
+
+	/* Coarse-to-fine search (goal_pipeline_pyramid): */
+	double coarseScale = 0.25;		//!< Downscale factor for the coarse pass; 0 disables it.
+	unsigned int coarseMaxCandidates = 4;	//!< Maximum number of candidate windows refined at full resolution.
+
+	cv::Mat coarse;				//!< Downscaled input frame.
+	cv::Mat coarseMask;			//!< Color threshold of the downscaled frame.
+	contour_arena coarseArena;		//!< Outlines of the blobs found in coarseMask.
+	std::vector<cv::Rect> windows;		//!< Full-resolution candidate windows.
+
+	/*! \fn getMorphKernel(cv::Size sz)
+	 *  \brief Get a rectangular structuring element of the given size, creating it only when the size changes.
+	 */
+	const cv::Mat& getMorphKernel(cv::Size sz);
+
+	cv::Rect beginFrame(cv::Size frameSz);
+	void clearCandidates();
+	void endFrame(const std::vector<contour_record>& detections);
+};
+
+/*
+ * The context overloads of goal_preprocess_pipeline and goal_pipeline are meant to be used as a pair:
+ * the preprocess step picks (and processes only) ctx.roi, and goal_pipeline maps contours found in
+ * that window back to full-frame coordinates.
+ */
+extern cv::Mat& goal_preprocess_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output=false, bool live_output=false);
+extern const scoredContour& goal_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output=false, bool window_output=false);
+
+extern const scoredContour& goal_pipeline_pyramid(cv::Mat frame, visproc_context& ctx, bool suppress_output=false);
+
+extern cv::Mat& boulder_preprocess_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output=false, bool live_output=false);
+extern const std::vector<scoredContour>& boulder_pipeline(cv::Mat input, visproc_context& ctx, bool suppress_output=false, bool window_output=false);
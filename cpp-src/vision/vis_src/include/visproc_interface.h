@@ -20,5 +20,7 @@ extern double goal_pipeline_full(cv::Mat input);
 extern double getDistance(cv::Size targetSize, cv::Size fovSize);
 extern double getDistance(double observedHeight, double targetHeight, double frameHeight, double fovAngle);
 extern double getAngleOffCenter(double midpointX, double frameWidth, double fovAngle);
+extern double getDistance(const cv::Rect& bounds, double targetHeight, cv::Size frameSz);
+extern double getAngleOffCenter(const cv::Rect& bounds, cv::Size frameSz);
 extern double getFOVAngleHoriz(cv::Size observedSize, cv::Size targetSize, cv::Size fovSize, double distance);
 extern double getFOVAngleVert(cv::Size observedSize, cv::Size targetSize, cv::Size fovSize, double distance);
@@ -0,0 +1,91 @@
+#pragma once
+#include "opencv2/core.hpp"
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+
+/*! \file visproc_profiler.h
+ *  \brief Per-stage latency histograms for the vision pipelines.
+ *
+ *  Each preprocessing stage (the ones with drawOut("stageN") hooks) and the contour scoring steps
+ *  are wrapped in VISPROC_PROFILE() scoped timers. When the library is built with VISPROC_PROFILING
+ *  defined (make PROFILING=1), every timer adds its latency to a lock-free histogram for its stage,
+ *  which can be read at any time from any thread with visproc_profileReport(). Otherwise the timers
+ *  compile to nothing.
+ *
+ *  Histograms have four buckets per power of two microseconds, so reported percentiles are upper
+ *  bounds that are at most 25% above the true value (exact below 8 us).
+ *
+ *  With strip-parallel preprocessing, each strip records its own sample for the stages it runs.
+ */
+
+/*! \enum profile_stage
+ *  \brief Timed regions. PROF_THRESHOLD includes PROF_HSV, and PROF_PREPROCESS includes stages 1-5.
+ */
+enum profile_stage {
+	PROF_PREPROCESS,	//!< Whole preprocess pipeline call.
+	PROF_HSV,		//!< stage1: HSV conversion and blur (THRES_LEGACY only).
+	PROF_THRESHOLD,		//!< stage2: color threshold.
+	PROF_MORPH,		//!< stage3: erosion / dilation.
+	PROF_BLUR,		//!< stage4: blur before edge detection.
+	PROF_CANNY,		//!< stage5: Canny.
+	PROF_CONTOURS,		//!< findContours, or blob labeling.
+	PROF_SCORING,		//!< Scoring candidates.
+	PROF_SCORING_PARALLEL,	//!< Scoring candidates on the thread pool (included in PROF_SCORING); its count is the number of such calls.
+	PROF_STAGE_COUNT
+};
+
+/*! \class latency_histogram
+ *  \brief Log-bucketed latency histogram that can be updated and read concurrently without locks.
+ *
+ *  Objects with static storage duration start out zeroed; others must be reset() before use.
+ */
+class latency_histogram {
+public:
+	static const int nBuckets = 128;
+
+	void record(uint32_t us);
+	void reset();
+
+	uint32_t count() const { return n.load(std::memory_order_relaxed); };
+	uint32_t max() const { return maxUs.load(std::memory_order_relaxed); };
+	double mean() const;
+	uint32_t percentile(double p) const;
+
+	static int bucketIndex(uint32_t us);
+	static uint32_t bucketUpperBound(int idx);
+
+private:
+	std::atomic<uint32_t> buckets[nBuckets];
+	std::atomic<uint32_t> n;
+	std::atomic<uint32_t> maxUs;
+	std::atomic<uint64_t> totalUs;
+};
+
+extern void visproc_profileRecord(profile_stage stage, int64_t ticks);
+extern void visproc_profileReport(std::ostream& out);
+extern void visproc_profileReset();
+extern bool visproc_profilingEnabled();
+extern const char* profileStageName(profile_stage stage);
+
+/*! \class scoped_stage_timer
+ *  \brief Records the time between its construction and destruction against a stage.
+ */
+class scoped_stage_timer {
+public:
+	scoped_stage_timer(profile_stage s) : stage(s), start(cv::getTickCount()) {};
+	~scoped_stage_timer() { visproc_profileRecord(stage, cv::getTickCount() - start); };
+
+private:
+	profile_stage stage;
+	int64_t start;
+};
+
+#define VISPROC_PROFILE_CAT2(a, b) a##b
+#define VISPROC_PROFILE_CAT(a, b) VISPROC_PROFILE_CAT2(a, b)
+
+#ifdef VISPROC_PROFILING
+#define VISPROC_PROFILE(stage) scoped_stage_timer VISPROC_PROFILE_CAT(visprocTimer_, __LINE__)(stage)
+#else
+#define VISPROC_PROFILE(stage)
+#endif
@@ -0,0 +1,107 @@
+#include "multi_target.h"
+#include "visproc_common.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+/*! \file multi_target.cpp
+ *  \brief Shared-threshold detection of several target types per frame.
+ */
+
+/*!	\fn multi_target_detector::addTarget(const target_class& target)
+ *	\brief Register a target type.
+ *	\return The target's index (used in target_detection::target), or -1 if MULTI_THRES_MAX targets are already registered.
+ */
+int multi_target_detector::addTarget(const target_class& target) {
+	if(targets.size() >= (size_t)MULTI_THRES_MAX) {
+		return -1;
+	}
+
+	targets.push_back(target);
+	contexts.push_back(visproc_context());
+	masks.push_back(cv::Mat());
+	ranges.push_back(hsv_range());
+	return targets.size() - 1;
+}
+
+/* Compute every target's color mask, sharing as much of the work as the threshold mode allows. */
+void multi_target_detector::threshold(cv::Mat frame, bool live_output) {
+	VISPROC_PROFILE(PROF_THRESHOLD);
+
+	const int n = targets.size();
+	for(int i=0;i<n;i++) {
+		ranges[i] = targets[i].range();
+	}
+
+	if(visproc_thresholdMode == THRES_LEGACY) {
+		{
+			VISPROC_PROFILE(PROF_HSV);
+			cv::cvtColor(frame, hsv, CV_BGR2HSV);
+			cv::GaussianBlur(hsv, hsv, targets[0].hsvBlurSize, targets[0].hsvBlurSigma, targets[0].hsvBlurSigma, targets[0].hsvBlurBorder);
+		}
+		drawOut("stage1", hsv, live_output);
+
+		for(int i=0;i<n;i++) {
+			cv::inRange(hsv, cv::Scalar(ranges[i].min[0], ranges[i].min[1], ranges[i].min[2]), cv::Scalar(ranges[i].max[0], ranges[i].max[1], ranges[i].max[2]), masks[i]);
+		}
+	} else if(visproc_thresholdMode == THRES_LUT) {
+		for(int i=0;i<n;i++) {
+			hsv_color_lut& lut = targets[i].colorLUT();
+			lut.update(ranges[i]);
+			lut.apply(frame, masks[i]);
+		}
+	} else {
+		multiHSVThreshold(frame, masks.data(), ranges.data(), n, visproc_thresholdMode);
+	}
+
+	/* Hand each mask to its target's context (a header copy, not a pixel copy) */
+	for(int i=0;i<n;i++) {
+		contexts[i].mask = masks[i];
+	}
+}
+
+/*!	\fn multi_target_detector::detect(cv::Mat frame, bool suppress_output, bool live_output)
+ *	\brief Search a frame for every registered target type.
+ *
+ *	\param frame Input frame (BGR).
+ *	\param suppress_output If false, then debugging data is written to stdout.
+ *	\param live_output If true, then intermediate pipeline image streams are output to GUI windows.
+ *	\return Every accepted candidate (at most getContext(i).maxResults of target i, if set), grouped by target
+ *	in registration order and sorted best first within each target. Valid until the next detect().
+ */
+const std::vector<target_detection>& multi_target_detector::detect(cv::Mat frame, bool suppress_output, bool live_output) {
+	threshold(frame, live_output);
+
+	size_t count = 0;
+	for(size_t i=0;i<targets.size();i++) {
+		visproc_context& ctx = contexts[i];
+
+		if(!suppress_output) { std::cout << "Target " << targets[i].name << ":" << std::endl; }
+
+		cv::Mat& processed = targets[i].processMask(ctx, live_output);
+		ctx.clearCandidates();
+		targets[i].score(processed, cv::Point(), ctx, suppress_output, live_output, ctx.maxResults);
+
+		selectTopScores(ctx.scores, ctx.maxResults);
+
+		/* resize() + copyTo() reuse the point storage left over from previous frames */
+		if(detections.size() < count + ctx.scores.size()) {
+			detections.resize(count + ctx.scores.size());
+		}
+		for(size_t j=0;j<ctx.scores.size();j++) {
+			target_detection& d = detections[count + j];
+			d.target = i;
+			d.score = ctx.scores[j].first;
+			d.degraded = ctx.frameDegraded;
+			contour_record r = target_record(ctx, ctx.scores[j]);
+			d.shape = r;
+			ctx.arena.copyTo(r, d.points);
+		}
+		count += ctx.scores.size();
+	}
+	detections.resize(count);
+
+	return detections;
+}
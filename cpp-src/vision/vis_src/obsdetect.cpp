@@ -1,147 +1,309 @@
+#include "obsdetect.h"
+#include "visproc_interface.h"
+#include "camera_model.h"
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
-#include "opencv2/imgcodecs.hpp"
-#include "opencv2/highgui.hpp"
-#include "opencv2/videoio.hpp"
 #include <vector>
 #include <algorithm>
-#include <utility>
-#include <iostream>
+#include <limits>
+#include <cstring>
+#include <cmath>
 
-typedef std::vector<cv::Point> contour;
-typedef unsigned int** hv_histogram;
+/*! \file obsdetect.cpp
+ *  \brief Obstacle masking against reference floor histograms.
+ */
 
-contour createTrapezoid(unsigned int topWidth, unsigned int baseWidth, unsigned int height, cv::Point bottomLeft) {
-	contour out;
+std::vector<cv::Point> createTrapezoid(unsigned int topWidth, unsigned int baseWidth, unsigned int height, cv::Point bottomLeft) {
+	std::vector<cv::Point> out;
 	out.push_back(bottomLeft);
 	out.push_back(cv::Point(bottomLeft.x + baseWidth, bottomLeft.y));
 	out.push_back(cv::Point(bottomLeft.x + topWidth + ((baseWidth - topWidth)/2), bottomLeft.y-height));
-	out.push_back(cv::Point(bottomLeft.x + ((baseWidth - topWidth)/2), bottomLeft.y-height));	
+	out.push_back(cv::Point(bottomLeft.x + ((baseWidth - topWidth)/2), bottomLeft.y-height));
 	return out;
 }
 
-const contour refTrpz = createTrapezoid(160, 480, 120, cv::Point(80, 470));
-const unsigned int valThres = 80;
-const unsigned int satThres = 60;
+const std::vector<cv::Point> obs_refTrapezoid = createTrapezoid(160, 480, 120, cv::Point(80, 470));
+const unsigned int obs_valThres = 80;
+const unsigned int obs_satThres = 60;
 
-int valHistBinThres = 370;
-int satHistBinThres = 325;
-int hueHistBinThres = 300;
+int obs_valHistBinThres = 370;
+int obs_satHistBinThres = 325;
+int obs_hueHistBinThres = 300;
 
-hv_histogram getReferenceHistograms(cv::Mat src) {
-	cv::Mat refTrap(src.size(), src.type());
-	cv::Mat mask(src.size(), CV_8U);
+double obs_cameraHeight = 12.0;
+double obs_cameraTilt = 0.0;
 
-	cv::fillConvexPoly(mask, refTrpz.data(), 4, 255);	
-	src.copyTo(refTrap, mask);
-
-	hv_histogram hists = new unsigned int*[3];
-	hists[0] = new unsigned int[256];
-	hists[1] = new unsigned int[256];
-	hists[2] = new unsigned int[256];
-
-	unsigned int* hueHist = hists[0];
-	unsigned int* satHist = hists[1];
-	unsigned int* valHist = hists[2];
+void obstacle_histograms::clear() {
+	std::memset(hue, 0, sizeof(hue));
+	std::memset(sat, 0, sizeof(sat));
+	std::memset(val, 0, sizeof(val));
+}
 
+void obstacle_model::update(const obstacle_histograms& h, float decay) {
+	const float keep = valid ? decay : 0.0f;
+	const float add = 1.0f - keep;
 	for(unsigned int i=0;i<256;i++) {
-		hueHist[i] = 0;
-		satHist[i] = 0;
-		valHist[i] = 0;
+		hue[i] = (keep * hue[i]) + (add * h.hue[i]);
+		sat[i] = (keep * sat[i]) + (add * h.sat[i]);
+		val[i] = (keep * val[i]) + (add * h.val[i]);
 	}
+	valid = true;
+}
 
-	for(cv::MatIterator_<cv::Vec3b> it = refTrap.begin<cv::Vec3b>(); it != refTrap.end<cv::Vec3b>(); ++it) {
-		if((*it)[2] > 0) {		
-			valHist[(*it)[2]]++;
-			if((*it)[2] >= valThres) {
-				satHist[(*it)[1]]++;				
-				if((*it)[1] >= satThres) {
-					hueHist[(*it)[0]]++;
-				}
-			}
+/* Find the rows of obs_refTrapezoid, as cv::fillConvexPoly fills it; only needed when the frame size changes. */
+static void obs_buildSpans(cv::Size sz, obstacle_context& ctx) {
+	cv::Mat refMask = cv::Mat::zeros(sz, CV_8U);
+	cv::fillConvexPoly(refMask, obs_refTrapezoid.data(), obs_refTrapezoid.size(), 255);
+
+	ctx.refSpans.clear();
+	for(int y=0;y<sz.height;y++) {
+		const uchar* m = refMask.ptr<uchar>(y);
+		int x0 = 0;
+		while((x0 < sz.width) && (m[x0] == 0)) {
+			x0++;
+		}
+		if(x0 == sz.width) {
+			continue;
 		}
-	}
 
-	return hists;
-}
+		int x1 = sz.width;
+		while(m[x1-1] == 0) {
+			x1--;
+		}
 
-cv::Mat obs_getObsMask(cv::Mat src) {
-	cv::Mat out = cv::Mat::zeros(src.size(), CV_8U);
-	cv::Mat tmp(src.size(), src.type());
+		obstacle_span span = { y, x0, x1 };	// convex, so there are no gaps in between
+		ctx.refSpans.push_back(span);
+	}
+	ctx.refSize = sz;
+}
 
-	cv::GaussianBlur(src, tmp, cv::Size(5,5), 2.5, 2.5, cv::BORDER_DEFAULT);
-	cv::cvtColor(tmp, tmp, CV_BGR2HSV);
-	
-	hv_histogram refHist = getReferenceHistograms(tmp);
+/*!	\fn obs_getReferenceHistograms(const cv::Mat& hsv, obstacle_context& ctx)
+ *	\brief Fill ctx.hist from the pixels of an HSV frame inside obs_refTrapezoid.
+ *
+ *	Only the trapezoid's row spans are scanned. Pixels with a value of 0 are left out, so that value 0
+ *	always counts as an obstacle.
+ */
+void obs_getReferenceHistograms(const cv::Mat& hsv, obstacle_context& ctx) {
+	CV_Assert(hsv.type() == CV_8UC3);
+
+	if(ctx.refSize != hsv.size()) {
+		obs_buildSpans(hsv.size(), ctx);
+	}
 
-	for(cv::MatIterator_<cv::Vec3b> it = tmp.begin<cv::Vec3b>(); it != tmp.end<cv::Vec3b>(); ++it) {
-		unsigned char& p = out.at<unsigned char>(it.pos());
+	obstacle_histograms& h = ctx.hist;
+	h.clear();
 
-		if(refHist[2][(*it)[2]] < valHistBinThres) {
-			p = 255;
-			continue;		
-		}
+	for(size_t i=0;i<ctx.refSpans.size();i++) {
+		const obstacle_span& span = ctx.refSpans[i];
+		const uchar* p = hsv.ptr<uchar>(span.y) + (3 * span.x0);
+		const uchar* end = hsv.ptr<uchar>(span.y) + (3 * span.x1);
 
-		if((*it)[2] >= valThres) {
-			if(refHist[1][(*it)[1]] < satHistBinThres) {
-				p = 255;
-				continue;			
+		for(;p != end;p += 3) {
+			if(p[2] == 0) {
+				continue;
 			}
-			if((*it)[1] >= satThres) {
-				if(refHist[0][(*it)[0]] < hueHistBinThres) {
-					p = 255;				
+
+			h.val[p[2]]++;
+			if(p[2] >= obs_valThres) {
+				h.sat[p[1]]++;
+				if(p[1] >= obs_satThres) {
+					h.hue[p[0]]++;
 				}
 			}
 		}
 	}
-
-	return out;
 }
 
-int main(int argc, char** argv) {
-	cv::VideoCapture cap(1); // open cam 1
-	if(!cap.isOpened())  // check if we succeeded
-		return -1;
-
-	cv::namedWindow("input");
-	cv::namedWindow("mask");
-	cv::namedWindow("output");
-
-	std::cout << "Width: " << cap.get(CV_CAP_PROP_FRAME_WIDTH) << std::endl;
-	std::cout << "Height: " << cap.get(CV_CAP_PROP_FRAME_HEIGHT) << std::endl;
+/*!	\fn obs_resetModel(obstacle_context& ctx)
+ *	\brief Forget the floor model, e.g. when the camera or lighting changes; the next frame rebuilds it.
+ */
+void obs_resetModel(obstacle_context& ctx) {
+	ctx.model.valid = false;
+	ctx.frameCount = 0;
+}
 
-	cvCreateTrackbar("Val Thres", "input", &valHistBinThres, 500, NULL);
-	cvCreateTrackbar("Sat Thres", "input", &satHistBinThres, 500, NULL);
-	cvCreateTrackbar("Hue Thres", "input", &hueHistBinThres, 500, NULL);
+/*!	\fn obs_buildLUTs(obstacle_context& ctx)
+ *	\brief Fold ctx.model and the thresholds into ctx's per-channel lookup tables: 255 where a test holds, else 0.
+ */
+void obs_buildLUTs(obstacle_context& ctx) {
+	const float valT = std::max(0, obs_valHistBinThres);
+	const float satT = std::max(0, obs_satHistBinThres);
+	const float hueT = std::max(0, obs_hueHistBinThres);
+	const obstacle_model& m = ctx.model;
+
+	ctx.hueReject.create(1, 256, CV_8U);
+	ctx.satReject.create(1, 256, CV_8U);
+	ctx.satGate.create(1, 256, CV_8U);
+	ctx.valReject.create(1, 256, CV_8U);
+	ctx.valGate.create(1, 256, CV_8U);
+	for(unsigned int i=0;i<256;i++) {
+		ctx.hueReject.at<uchar>(i) = (m.hue[i] < hueT) ? 255 : 0;
+		ctx.satReject.at<uchar>(i) = (m.sat[i] < satT) ? 255 : 0;
+		ctx.satGate.at<uchar>(i) = (i >= obs_satThres) ? 255 : 0;
+		ctx.valReject.at<uchar>(i) = (m.val[i] < valT) ? 255 : 0;
+		ctx.valGate.at<uchar>(i) = (i >= obs_valThres) ? 255 : 0;
+	}
+}
 
-	while(true) {
-		cv::Mat src;
-		cap >> src;
+/*!	\fn obs_classify(const cv::Mat& hsv, obstacle_context& ctx)
+ *	\brief Write the obstacle mask for an HSV frame to ctx.mask, using the tables from obs_buildLUTs().
+ *
+ *	Each pixel is obstacle = V.reject | (V.gate & (S.reject | (S.gate & H.reject))). The frame is split into
+ *	channels once, and the expression is evaluated inside out with cv::LUT and cv::bitwise_and / bitwise_or
+ *	over whole planes: every pass is a kernel that the OpenCV build itself vectorizes (NEON on the ARM
+ *	target), which our own -Og code would not be.
+ */
+void obs_classify(const cv::Mat& hsv, obstacle_context& ctx) {
+	CV_Assert(hsv.type() == CV_8UC3);
+	cv::split(hsv, ctx.channels);
+
+	cv::LUT(ctx.channels[0], ctx.hueReject, ctx.mask);
+	cv::LUT(ctx.channels[1], ctx.satGate, ctx.test);
+	cv::bitwise_and(ctx.mask, ctx.test, ctx.mask);
+	cv::LUT(ctx.channels[1], ctx.satReject, ctx.test);
+	cv::bitwise_or(ctx.mask, ctx.test, ctx.mask);
+	cv::LUT(ctx.channels[2], ctx.valGate, ctx.test);
+	cv::bitwise_and(ctx.mask, ctx.test, ctx.mask);
+	cv::LUT(ctx.channels[2], ctx.valReject, ctx.test);
+	cv::bitwise_or(ctx.mask, ctx.test, ctx.mask);
+}
 
-		std::vector<contour> drawVec;
-		drawVec.push_back(refTrpz);
+/*!	\fn obs_getObsMask(cv::Mat src, obstacle_context& ctx)
+ *	\brief Find obstacles in a BGR frame.
+ *
+ *	The floor model is updated from this frame if it is due (see obstacle_context::refreshEvery).
+ *	\return ctx.mask: 255 where there are obstacles, 0 on floor.
+ */
+cv::Mat& obs_getObsMask(cv::Mat src, obstacle_context& ctx) {
+	cv::GaussianBlur(src, ctx.blurred, cv::Size(5,5), 2.5, 2.5, cv::BORDER_DEFAULT);
+	cv::cvtColor(ctx.blurred, ctx.hsv, CV_BGR2HSV);
+
+	/* The thresholds may change at any time, so the (cheap) tables are rebuilt even when the model isn't */
+	if(!ctx.model.valid || ((ctx.frameCount % std::max(1u, ctx.refreshEvery)) == 0)) {
+		obs_getReferenceHistograms(ctx.hsv, ctx);
+		ctx.model.update(ctx.hist, ctx.decay);
+	}
+	ctx.frameCount++;
+	obs_buildLUTs(ctx);
+	obs_classify(ctx.hsv, ctx);
 
-		cv::Mat tmp;
-		src.copyTo(tmp);
-		cv::drawContours(tmp, drawVec, -1, cv::Scalar(255,255,255));
+	return ctx.mask;
+}
 
-		cv::imshow("input", tmp);
-	
-		cv::Mat obsMask = obs_getObsMask(src);
+/*!	\fn obs_getObsMask(cv::Mat src)
+ *	\brief Find obstacles in a BGR frame.
+ *
+ *	Allocates a fresh set of buffers on every call; long-running callers should keep an obstacle_context instead.
+ */
+cv::Mat obs_getObsMask(cv::Mat src) {
+	obstacle_context ctx;
+	return obs_getObsMask(src, ctx);
+}
 
-		cv::imshow("mask", obsMask);
+/* Ground tables for obs_freeSpace(), from camera_model::projectToGroundPlane: visproc_camera once it is
+ * calibrated, else an ideal camera with the nominal fovHoriz / fovVert.
+ *
+ * The projection is separable: the lateral offset of pixel (x, y) is a per-row scale times the column's ray
+ * tangent. So one projection per row, at the right edge of the frame, gives rowDist[y] and rowLateral[y]
+ * (the lateral offset at that edge), and one per column, along the bottom row, gives colLateral[x]
+ * (the lateral offset at x as a fraction of that at the right edge). */
+static void obs_buildFreeSpaceTables(cv::Size sz, unsigned int nBins, free_space_scan& scan) {
+	const float inf = std::numeric_limits<float>::infinity();
+	const bool calibrated = visproc_camera.calibrated();
+	if(calibrated) {
+		visproc_camera.setResolution(sz);
+	} else {
+		scan.ideal.setIdeal(sz, fovHoriz, fovVert);
+	}
+	const camera_model& cam = calibrated ? visproc_camera : scan.ideal;
+
+	/* Floor under the bottom edge of each row */
+	scan.rowDist.resize(sz.height);
+	scan.rowLateral.resize(sz.height);
+	for(int y=0;y<sz.height;y++) {
+		std::pair<double, double> p = cam.projectToGroundPlane(cv::Point2f(sz.width, y + 1), obs_cameraHeight, obs_cameraTilt);
+		const bool ground = std::isfinite(p.second);
+		scan.rowDist[y] = ground ? (float)p.second : inf;
+		scan.rowLateral[y] = ground ? (float)p.first : 0;
+	}
 
-		cv::Mat edgedet;
+	/* The bottom row is the nearest to the ground; if even it is above the horizon, nothing is in range */
+	const double edgeLateral = scan.rowLateral[sz.height - 1];
+	std::vector<double> bearing(sz.width);
+	scan.colLateral.resize(sz.width);
+	for(int x=0;x<sz.width;x++) {
+		bearing[x] = cam.columnAngle(x + 0.5);
+		std::pair<double, double> p = cam.projectToGroundPlane(cv::Point2f(x + 0.5, sz.height), obs_cameraHeight, obs_cameraTilt);
+		scan.colLateral[x] = (edgeLateral != 0) ? (float)(p.first / edgeLateral) : 0;
+	}
 
-		cv::blur(obsMask, edgedet, cv::Size(3,3));
+	const double left = cam.columnAngle(0);
+	const double right = cam.columnAngle(sz.width);
+	scan.startAngle = left;
+	scan.angleStep = (right - left) / nBins;
+
+	/* Bearings increase left to right, so each bin is a run of columns */
+	scan.binStart.assign(nBins + 1, sz.width);
+	int x = 0;
+	for(unsigned int i=0;i<nBins;i++) {
+		double edge = left + (i * scan.angleStep);
+		while((x < sz.width) && (bearing[x] < edge)) {
+			x++;
+		}
+		scan.binStart[i] = x;
+	}
 
-		cv::Mat detOut;		
-		cv::Canny(edgedet, detOut, 10, 20);		
+	cv::Mat col(sz.height, 1, CV_16U);
+	for(int y=0;y<sz.height;y++) {
+		col.at<uint16_t>(y) = y + 1;
+	}
+	cv::repeat(col, 1, sz.width, scan.rowRamp);
 
-		cv::imshow("output", detOut);
+	scan.size = sz;
+	scan.height = obs_cameraHeight;
+	scan.tilt = obs_cameraTilt;
+	scan.calibrated = calibrated;
+}
 
-		if(cv::waitKey(30) > 0) break;
+/*!	\fn obs_freeSpace(const cv::Mat& mask, unsigned int nBins, free_space_scan& scan)
+ *	\brief Reduce an obstacle mask to the floor distance to the nearest obstacle at nBins bearings.
+ *
+ *	The lowest obstacle pixel of every column is found with one masked row-index ramp and a column
+ *	reduction, as in particleHeightProfile(); its bottom edge is taken to be where the obstacle meets the
+ *	floor, and projected onto it (with camera_model::projectToGroundPlane, for a camera obs_cameraHeight above
+ *	the floor and tilted down by obs_cameraTilt). Its range is the straight-line floor distance to that point.
+ *	Each bin reports the minimum range of its columns, so that an obstacle only one column wide still
+ *	shows up; speckle in the mask shows up too, so filter the mask first if that matters.
+ *	\param mask Obstacle mask from obs_getObsMask(): 255 for obstacles, 0 on floor.
+ *	\param nBins Number of bearings; clipped to half the mask width, so that every bin has at least one column.
+ */
+void obs_freeSpace(const cv::Mat& mask, unsigned int nBins, free_space_scan& scan) {
+	CV_Assert(mask.type() == CV_8UC1);
+	CV_Assert(mask.rows <= 0xFFFF);
+	nBins = std::max(1u, std::min(nBins, (unsigned int)mask.cols / 2));
+
+	if((scan.size != mask.size()) || (scan.binStart.size() != nBins + 1) || (scan.height != obs_cameraHeight)
+		|| (scan.tilt != obs_cameraTilt) || (scan.calibrated != visproc_camera.calibrated())) {
+		obs_buildFreeSpaceTables(mask.size(), nBins, scan);
 	}
 
-	return 0;
+	cv::compare(mask, 127, scan.bin, cv::CMP_GT);
+	scan.rows.create(mask.size(), CV_16U);
+	scan.rows.setTo(0);
+	scan.rowRamp.copyTo(scan.rows, scan.bin);
+	cv::reduce(scan.rows, scan.lowest, 0, cv::REDUCE_MAX);
+
+	const float inf = std::numeric_limits<float>::infinity();
+	const uint16_t* lowest = scan.lowest.ptr<uint16_t>(0);
+	scan.range.assign(nBins, inf);
+	for(unsigned int i=0;i<nBins;i++) {
+		float nearest = inf;
+		for(int x=scan.binStart[i];x<scan.binStart[i+1];x++) {
+			if(lowest[x] > 0) {
+				const int y = lowest[x] - 1;
+				nearest = std::min(nearest, (float)std::hypot(scan.rowLateral[y] * scan.colLateral[x], scan.rowDist[y]));
+			}
+		}
+		scan.range[i] = nearest;
+	}
 }
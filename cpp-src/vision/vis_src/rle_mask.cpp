@@ -0,0 +1,228 @@
+#include "rle_mask.h"
+#include "opencv2/core.hpp"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+/*! \file rle_mask.cpp
+ *  \brief Construction, conversion and morphology for run-length encoded masks.
+ */
+
+/*!	\fn rle_mask::reset(cv::Size size)
+ *	\brief Empty the mask and set its dimensions, ready for rows to be appended.
+ */
+void rle_mask::reset(cv::Size size) {
+	sz = size;
+	runList.clear();
+	rowStart.resize(sz.height + 1);
+	rowStart[0] = 0;
+	scratch.resize(sz.width);
+}
+
+/*!	\fn rle_mask::appendRun(int y, int x0, int x1)
+ *	\brief Add a run to row y. Runs must be added left to right; touching runs are merged.
+ */
+void rle_mask::appendRun(int y, int x0, int x1) {
+	if((runList.size() > (size_t)rowStart[y]) && (runList.back().x1 >= x0)) {
+		runList.back().x1 = std::max(runList.back().x1, x1);
+		return;
+	}
+
+	rle_run r = {y, x0, x1};
+	runList.push_back(r);
+}
+
+/*!	\fn rle_mask::endRow(int y)
+ *	\brief Finish row y after its runs have been added with appendRun().
+ */
+void rle_mask::endRow(int y) {
+	rowStart[y+1] = runList.size();
+}
+
+/*!	\fn rle_mask::appendRow(int y, const unsigned char* row)
+ *	\brief Encode a row of size().width bytes; nonzero bytes are set pixels.
+ */
+void rle_mask::appendRow(int y, const unsigned char* row) {
+	int x = 0;
+	while(x < sz.width) {
+		if(!row[x]) {
+			x++;
+			continue;
+		}
+
+		int x0 = x;
+		while((x < sz.width) && row[x]) {
+			x++;
+		}
+		appendRun(y, x0, x);
+	}
+	endRow(y);
+}
+
+/*!	\fn rle_mask::fromMat(const cv::Mat& mask)
+ *	\brief Encode a CV_8U mask (nonzero pixels are set).
+ */
+void rle_mask::fromMat(const cv::Mat& mask) {
+	CV_Assert(mask.type() == CV_8U);
+
+	reset(mask.size());
+	for(int y=0;y<mask.rows;y++) {
+		appendRow(y, mask.ptr<unsigned char>(y));
+	}
+}
+
+/*!	\fn rle_mask::toMat(cv::Mat& out)
+ *	\brief Decode to a 0 / 255 CV_8U mask, e.g. for drawOut().
+ */
+void rle_mask::toMat(cv::Mat& out) const {
+	out.create(sz, CV_8U);
+	out = cv::Scalar(0);
+
+	for(size_t i=0;i<runList.size();i++) {
+		const rle_run& r = runList[i];
+		memset(out.ptr<unsigned char>(r.y) + r.x0, 255, r.x1 - r.x0);
+	}
+}
+
+/*!	\fn rle_mask::area()
+ *	\brief Number of set pixels.
+ */
+size_t rle_mask::area() const {
+	size_t n = 0;
+	for(size_t i=0;i<runList.size();i++) {
+		n += runList[i].x1 - runList[i].x0;
+	}
+	return n;
+}
+
+/* Intersect two sorted lists of disjoint runs. */
+static void intersectRuns(const std::vector<rle_run>& a, const rle_run* b, const rle_run* bEnd, std::vector<rle_run>& out) {
+	out.clear();
+
+	std::vector<rle_run>::const_iterator ia = a.begin();
+	while((ia != a.end()) && (b != bEnd)) {
+		int x0 = std::max(ia->x0, b->x0);
+		int x1 = std::min(ia->x1, b->x1);
+		if(x0 < x1) {
+			rle_run r = {ia->y, x0, x1};
+			out.push_back(r);
+		}
+
+		if(ia->x1 < b->x1) {
+			++ia;
+		} else {
+			++b;
+		}
+	}
+}
+
+/* Union of two sorted lists of disjoint runs, merging runs that overlap or touch. */
+static void uniteRuns(const std::vector<rle_run>& a, const rle_run* b, const rle_run* bEnd, std::vector<rle_run>& out) {
+	out.clear();
+
+	std::vector<rle_run>::const_iterator ia = a.begin();
+	while((ia != a.end()) || (b != bEnd)) {
+		const rle_run* next;
+		if((b == bEnd) || ((ia != a.end()) && (ia->x0 <= b->x0))) {
+			next = &(*ia);
+			++ia;
+		} else {
+			next = b;
+			++b;
+		}
+
+		if((out.size() > 0) && (out.back().x1 >= next->x0)) {
+			out.back().x1 = std::max(out.back().x1, next->x1);
+		} else {
+			out.push_back(*next);
+		}
+	}
+}
+
+/*
+ * A rectangular min / max filter is separable: filter each row horizontally by growing or shrinking
+ * its runs, then combine each window of ksize.height rows by intersection (erosion) or union (dilation).
+ * Border handling matches cv::erode / cv::dilate with their default constant border: pixels outside
+ * the frame count as set for erosion and as clear for dilation.
+ */
+void rle_mask::morph(rle_mask& dst, cv::Size ksize, bool dilation) const {
+	CV_Assert(&dst != this);
+
+	const int ax = ksize.width / 2;
+	const int bx = ksize.width - 1 - ax;
+	const int ay = ksize.height / 2;
+	const int by = ksize.height - 1 - ay;
+
+	dst.reset(sz);
+
+	/* Horizontal pass */
+	dst.hpass.clear();
+	dst.hpassStart.resize(sz.height + 1);
+	dst.hpassStart[0] = 0;
+	for(int y=0;y<sz.height;y++) {
+		size_t rowFirst = dst.hpass.size();
+
+		for(const rle_run* r=rowBegin(y);r != rowEnd(y);++r) {
+			rle_run h = *r;
+			if(dilation) {
+				h.x0 = std::max(0, r->x0 - bx);
+				h.x1 = std::min(sz.width, r->x1 + ax);
+
+				if((dst.hpass.size() > rowFirst) && (dst.hpass.back().x1 >= h.x0)) {
+					dst.hpass.back().x1 = h.x1;
+					continue;
+				}
+			} else {
+				h.x0 = (r->x0 == 0) ? 0 : (r->x0 + ax);
+				h.x1 = (r->x1 == sz.width) ? sz.width : (r->x1 - bx);
+
+				if(h.x0 >= h.x1) {
+					continue;
+				}
+			}
+			dst.hpass.push_back(h);
+		}
+
+		dst.hpassStart[y+1] = dst.hpass.size();
+	}
+
+	/* Vertical pass */
+	const rle_run* hp = dst.hpass.data();
+	for(int y=0;y<sz.height;y++) {
+		int y0 = std::max(0, y - ay);
+		int y1 = std::min(sz.height - 1, y + by);
+
+		dst.accumA.assign(hp + dst.hpassStart[y0], hp + dst.hpassStart[y0+1]);
+		for(int yy=y0+1;(yy <= y1) && (dilation || (dst.accumA.size() > 0));yy++) {
+			if(dilation) {
+				uniteRuns(dst.accumA, hp + dst.hpassStart[yy], hp + dst.hpassStart[yy+1], dst.accumB);
+			} else {
+				intersectRuns(dst.accumA, hp + dst.hpassStart[yy], hp + dst.hpassStart[yy+1], dst.accumB);
+			}
+			std::swap(dst.accumA, dst.accumB);
+		}
+
+		for(size_t i=0;i<dst.accumA.size();i++) {
+			dst.appendRun(y, dst.accumA[i].x0, dst.accumA[i].x1);
+		}
+		dst.endRow(y);
+	}
+}
+
+/*!	\fn rle_mask::erode(rle_mask& dst, cv::Size ksize)
+ *	\brief Erode with a ksize rectangle anchored at its center. Equivalent to cv::erode with
+ *	getStructuringElement(MORPH_RECT, ksize) and default arguments.
+ *	\param dst Output mask; must not be this mask.
+ */
+void rle_mask::erode(rle_mask& dst, cv::Size ksize) const {
+	morph(dst, ksize, false);
+}
+
+/*!	\fn rle_mask::dilate(rle_mask& dst, cv::Size ksize)
+ *	\brief Dilate with a ksize rectangle anchored at its center. Equivalent to cv::dilate with
+ *	getStructuringElement(MORPH_RECT, ksize) and default arguments.
+ *	\param dst Output mask; must not be this mask.
+ */
+void rle_mask::dilate(rle_mask& dst, cv::Size ksize) const {
+	morph(dst, ksize, true);
+}
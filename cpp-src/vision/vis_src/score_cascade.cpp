@@ -0,0 +1,170 @@
+#include "score_cascade.h"
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+/*! \file score_cascade.cpp
+ *  \brief Test ordering and rejection statistics for score_cascade.
+ */
+
+static const char* goalTestNames[GOAL_TEST_COUNT] = { "area", "coverage", "aspect", "profile", "moment", "angle" };
+static const char* boulderTestNames[BOULDER_TEST_COUNT] = { "area", "circularity", "aspect" };
+
+score_cascade goal_cascade(goalTestNames, GOAL_TEST_COUNT, 1u << GOAL_TEST_PROFILE);	//!< Scoring order and statistics for goal candidates.
+score_cascade boulder_cascade(boulderTestNames, BOULDER_TEST_COUNT);	//!< Scoring order and statistics for boulder candidates.
+
+/* Tests run in declaration order by default, which for the built-in targets is cheapest first.
+ * Tests whose bits are set in disabledTests start out disabled (the area test can't be). */
+score_cascade::score_cascade(const char* const* testNames, int n, unsigned int disabledTests) : names(testNames), nTests(n), nActive(0), candidates(0) {
+	for(int i=0;i<maxTests;i++) {
+		rejected[i].store(0, std::memory_order_relaxed);
+	}
+	for(int i=0;i<n;i++) {
+		if((i == 0) || !(disabledTests & (1u << i))) {
+			order[nActive++] = i;
+		}
+	}
+}
+
+/*!	\fn score_cascade::setOrder(const std::string& list)
+ *	\brief Set the scoring test order from a comma-separated list of test names, e.g. "aspect,coverage,angle,moment".
+ *
+ *	Every enabled test but "area" (which always runs first) must be listed exactly once.
+ *	\return false if the list is invalid, in which case the order is unchanged.
+ */
+bool score_cascade::setOrder(const std::string& list) {
+	int newOrder[maxTests];
+	bool seen[maxTests] = {false};
+	int n = 1;
+
+	newOrder[0] = 0;
+
+	std::istringstream in(list);
+	std::string name;
+	while(std::getline(in, name, ',')) {
+		int t = 1;
+		while((t < nTests) && (name != names[t])) {
+			t++;
+		}
+		if((t == nTests) || seen[t] || !isEnabled(t)) {
+			return false;
+		}
+
+		seen[t] = true;
+		newOrder[n++] = t;
+	}
+
+	if(n != nActive) {
+		return false;
+	}
+
+	for(int i=0;i<nActive;i++) {
+		order[i] = newOrder[i];
+	}
+	return true;
+}
+
+/*!	\fn score_cascade::setEnabled(const std::string& name, bool enable)
+ *	\brief Enable or disable an optional test by name.
+ *
+ *	An enabled test is placed before the first test in the current order that is declared after it, so with
+ *	the default order it runs in its declared position. At least one test besides the area test must stay
+ *	enabled, since the score is the mean of those tests.
+ *	\return false if there is no such test, it is the area test, or it is the last optional test left enabled.
+ */
+bool score_cascade::setEnabled(const std::string& name, bool enable) {
+	int t = 1;
+	while((t < nTests) && (name != names[t])) {
+		t++;
+	}
+	if(t == nTests) {
+		return false;
+	}
+
+	if(enable == isEnabled(t)) {
+		return true;
+	}
+
+	if(enable) {
+		int pos = 1;
+		while((pos < nActive) && (order[pos] < t)) {
+			pos++;
+		}
+		for(int i=nActive;i>pos;i--) {
+			order[i] = order[i-1];
+		}
+		order[pos] = t;
+		nActive++;
+	} else {
+		if(nActive <= 2) {
+			return false;
+		}
+
+		int pos = 1;
+		while(order[pos] != t) {
+			pos++;
+		}
+		for(int i=pos;i<nActive-1;i++) {
+			order[i] = order[i+1];
+		}
+		nActive--;
+	}
+	return true;
+}
+
+bool score_cascade::isEnabled(int t) const {
+	for(int i=0;i<nActive;i++) {
+		if(order[i] == t) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string score_cascade::getOrder() const {
+	std::string out;
+	for(int i=1;i<nActive;i++) {
+		if(i > 1) {
+			out += ",";
+		}
+		out += names[order[i]];
+	}
+	return out;
+}
+
+/*!	\fn score_cascade::report(std::ostream& out)
+ *	\brief Write the number of candidates rejected by each test (in the order they run), and the number accepted.
+ */
+void score_cascade::report(std::ostream& out) const {
+	uint32_t n[maxTests];
+	uint32_t sum = 0;
+	for(int i=0;i<nActive;i++) {
+		n[i] = rejected[order[i]].load(std::memory_order_relaxed);
+		sum += n[i];
+	}
+
+	/* Scoring threads may be counting while this runs */
+	uint32_t total = std::max(candidates.load(std::memory_order_relaxed), sum);
+
+	std::ios_base::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << total << " candidates, min score " << minScore << ":" << std::endl;
+	for(int i=0;i<nActive;i++) {
+		out << "  " << std::left << std::setw(12) << names[order[i]] << std::right << std::setw(10) << n[i] << " rejected";
+		out << " (" << std::fixed << std::setprecision(1) << ((total > 0) ? ((100.0 * n[i]) / total) : 0.0) << "%)" << std::endl;
+	}
+	out << "  " << std::left << std::setw(12) << "accepted" << std::right << std::setw(10) << (total - sum) << std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void score_cascade::resetCounts() {
+	candidates.store(0, std::memory_order_relaxed);
+	for(int i=0;i<maxTests;i++) {
+		rejected[i].store(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,66 @@
+#include "strip_parallel.h"
+#include "opencv2/core.hpp"
+#include <algorithm>
+
+/*! \file strip_parallel.cpp
+ *  \brief Strip-parallel execution of preprocessing stage chains.
+ */
+
+class strip_chain_body : public cv::ParallelLoopBody {
+public:
+	strip_chain_body(cv::Mat in, cv::Mat out, mask_chain_fn fn, const cv::Mat& k, int h, int n, std::vector<strip_buffers>& s) :
+		input(in), output(out), chain(fn), kernel(k), halo(h), nStrips(n), strips(s) {};
+
+	void operator()(const cv::Range& range) const {
+		for(int i=range.start;i<range.end;i++) {
+			int y0 = (input.rows * i) / nStrips;
+			int y1 = (input.rows * (i+1)) / nStrips;
+
+			/* Extend the band by the halo rows the stages need, except at the edges of the frame,
+			 * where the band edge is the frame edge and the stages' own border handling applies */
+			int h0 = std::max(0, y0 - halo);
+			int h1 = std::min(input.rows, y1 + halo);
+
+			strip_buffers& buf = strips[i];
+			chain(input.rowRange(h0, h1), buf.hsv, buf.mask, buf.morph, buf.blurred, kernel, false);
+
+			cv::Mat dst = output.rowRange(y0, y1);
+			buf.blurred.rowRange(y0 - h0, y1 - h0).copyTo(dst);
+		}
+	}
+
+private:
+	cv::Mat input;
+	cv::Mat output;
+	mask_chain_fn chain;
+	const cv::Mat& kernel;
+	int halo;
+	int nStrips;
+	std::vector<strip_buffers>& strips;
+};
+
+/*!	\fn stripParallelChain(cv::Mat input, cv::Mat& output, mask_chain_fn chain, const cv::Mat& kernel, int halo, int nStrips, std::vector<strip_buffers>& strips)
+ *	\brief Run a mask chain on horizontal bands of a frame using OpenCV's thread pool, and stitch the results.
+ *
+ *	Each band is processed together with halo extra rows above and below it, which are discarded afterwards.
+ *	If halo is at least the sum of the vertical kernel radii of the chain's stages, the stitched output is
+ *	bit-identical to running the chain on the whole frame at once.
+ *
+ *	\param input Input frame. May be a submatrix.
+ *	\param output Output mask, same size as input.
+ *	\param chain Stage chain to run on each band.
+ *	\param kernel Structuring element passed through to the chain.
+ *	\param halo Rows of context needed above and below each band.
+ *	\param nStrips Number of bands to split the frame into.
+ *	\param strips Per-band scratch buffers; resized as needed and reused across calls.
+ */
+void stripParallelChain(cv::Mat input, cv::Mat& output, mask_chain_fn chain, const cv::Mat& kernel, int halo, int nStrips, std::vector<strip_buffers>& strips) {
+	nStrips = std::max(1, std::min(nStrips, input.rows));
+
+	output.create(input.size(), CV_8U);
+	if(strips.size() < (size_t)nStrips) {
+		strips.resize(nStrips);
+	}
+
+	cv::parallel_for_(cv::Range(0, nStrips), strip_chain_body(input, output, chain, kernel, halo, nStrips, strips), nStrips);
+}
@@ -0,0 +1,171 @@
+#include "target_tracker.h"
+#include "opencv2/core.hpp"
+#include <algorithm>
+#include <cmath>
+
+/*! \file target_tracker.cpp
+ *  \brief Track association and alpha-beta filtering for target_tracker.
+ */
+
+void alpha_beta_filter::update(double z, double dt, double alpha, double beta) {
+	double xp = predict(dt);
+	double residual = z - xp;
+
+	x = xp + (alpha * residual);
+	if(dt > 0) {
+		v += (beta * residual) / dt;
+	}
+}
+
+cv::Rect target_track::bounds(double dt) const {
+	double w = std::max(1.0, state[TRACK_W].predict(dt));
+	double h = std::max(1.0, state[TRACK_H].predict(dt));
+	double cx = state[TRACK_CX].predict(dt);
+	double cy = state[TRACK_CY].predict(dt);
+
+	return cv::Rect((int)std::round(cx - (w / 2)), (int)std::round(cy - (h / 2)), (int)std::round(w), (int)std::round(h));
+}
+
+double target_tracker::secondsSince(const target_track& t, int64_t ticks) const {
+	return (ticks - t.ticks) / cv::getTickFrequency();
+}
+
+/*!	\fn target_tracker::update(const std::vector<tracker_measurement>& detections, int64_t ticks)
+ *	\brief Feed in the detections from one detector run.
+ *	\param detections Every detection from the frame (may be empty, which counts as a miss for every track).
+ *	\param ticks cv::getTickCount() when the frame was captured or processed.
+ */
+void target_tracker::update(const std::vector<tracker_measurement>& detections, int64_t ticks) {
+	/* Candidate pairs within the gate, closest first; ties go to the older track, then the earlier detection */
+	pairs.clear();
+	for(size_t t=0;t<tracks.size();t++) {
+		cv::Rect p = tracks[t].bounds(secondsSince(tracks[t], ticks));
+		double diag = std::max(1.0, std::sqrt((double)(p.width * p.width) + (p.height * p.height)));
+
+		for(size_t d=0;d<detections.size();d++) {
+			const cv::Rect& b = detections[d].bounds;
+			double dx = (b.x + (b.width / 2.0)) - (p.x + (p.width / 2.0));
+			double dy = (b.y + (b.height / 2.0)) - (p.y + (p.height / 2.0));
+			double cost = std::sqrt((dx * dx) + (dy * dy)) / diag;
+
+			if(cost <= gate) {
+				pairing pr = { cost, t, d };
+				pairs.push_back(pr);
+			}
+		}
+	}
+	std::sort(pairs.begin(), pairs.end(), [](const pairing& a, const pairing& b) {
+		return (a.cost < b.cost) || ((a.cost == b.cost) && ((a.track < b.track) || ((a.track == b.track) && (a.detection < b.detection))));
+	});
+
+	trackMatched.assign(tracks.size(), false);
+	detectionMatched.assign(detections.size(), false);
+
+	for(size_t i=0;i<pairs.size();i++) {
+		if(trackMatched[pairs[i].track] || detectionMatched[pairs[i].detection]) {
+			continue;
+		}
+		trackMatched[pairs[i].track] = true;
+		detectionMatched[pairs[i].detection] = true;
+
+		target_track& t = tracks[pairs[i].track];
+		const tracker_measurement& m = detections[pairs[i].detection];
+		double dt = secondsSince(t, ticks);
+
+		double z[TRACK_CHANNELS] = {
+			m.bounds.x + (m.bounds.width / 2.0), m.bounds.y + (m.bounds.height / 2.0),
+			(double)m.bounds.width, (double)m.bounds.height, m.distance, m.angle
+		};
+		for(int c=0;c<TRACK_CHANNELS;c++) {
+			t.state[c].update(z[c], dt, alpha, beta);
+		}
+
+		t.score = m.score;
+		t.hits++;
+		t.misses = 0;
+		t.ticks = ticks;
+	}
+
+	/* Unmatched tracks coast: advance them to this frame on their prediction */
+	size_t kept = 0;
+	for(size_t i=0;i<tracks.size();i++) {
+		target_track& t = tracks[i];
+		if(!trackMatched[i]) {
+			double dt = secondsSince(t, ticks);
+			for(int c=0;c<TRACK_CHANNELS;c++) {
+				t.state[c].x = t.state[c].predict(dt);
+			}
+			t.ticks = ticks;
+			t.misses++;
+		}
+
+		if(t.misses <= maxMisses) {
+			tracks[kept++] = t;
+		}
+	}
+	tracks.resize(kept);
+
+	for(size_t d=0;d<detections.size();d++) {
+		if(detectionMatched[d]) {
+			continue;
+		}
+
+		const tracker_measurement& m = detections[d];
+		target_track t;
+		t.id = nextId++;
+		t.state[TRACK_CX].reset(m.bounds.x + (m.bounds.width / 2.0));
+		t.state[TRACK_CY].reset(m.bounds.y + (m.bounds.height / 2.0));
+		t.state[TRACK_W].reset(m.bounds.width);
+		t.state[TRACK_H].reset(m.bounds.height);
+		t.state[TRACK_DISTANCE].reset(m.distance);
+		t.state[TRACK_ANGLE].reset(m.angle);
+		t.score = m.score;
+		t.hits = 1;
+		t.misses = 0;
+		t.ticks = ticks;
+		tracks.push_back(t);
+	}
+}
+
+/*!	\fn target_tracker::reset()
+ *	\brief Drop every track, e.g. when the camera stream restarts.
+ */
+void target_tracker::reset() {
+	tracks.clear();
+}
+
+/*!	\fn target_tracker::best()
+ *	\brief The confirmed track seen most recently (then with the highest score, then the oldest), or NULL if there are none.
+ */
+const target_track* target_tracker::best() const {
+	const target_track* out = NULL;
+	for(size_t i=0;i<tracks.size();i++) {
+		const target_track& t = tracks[i];
+		if(t.hits < confirmHits) {
+			continue;
+		}
+
+		if((out == NULL) || (t.misses < out->misses) || ((t.misses == out->misses) && (t.score > out->score))) {
+			out = &t;
+		}
+	}
+	return out;
+}
+
+/*!	\fn target_tracker::predict(int64_t ticks, cv::Rect& bounds, double& distance, double& angle, double& score)
+ *	\brief Extrapolate the best() track to a given time.
+ *	\return false (leaving the outputs unchanged) if there is no confirmed track.
+ */
+bool target_tracker::predict(int64_t ticks, cv::Rect& bounds, double& distance, double& angle, double& score) const {
+	const target_track* t = best();
+	if(t == NULL) {
+		return false;
+	}
+
+	double dt = secondsSince(*t, ticks);
+	bounds = t->bounds(dt);
+	distance = t->distance(dt);
+	angle = t->angle(dt);
+	score = t->score;
+	return true;
+}
@@ -1,5 +1,8 @@
 #include "visproc_common.h"
 #include "visproc_interface.h"
+#include "multi_target.h"
+#include "score_cascade.h"
+#include "obsdetect.h"
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/imgcodecs.hpp"
@@ -9,15 +12,306 @@
 #include <algorithm>
 #include <utility>
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <atomic>
 
 const int camID = 1;
 
+double elapsedMs(double startTicks) {
+	return (((double)cv::getTickCount() - startTicks) * 1000.0) / cv::getTickFrequency();
+}
+
 #ifdef VISPROC_BASIC_TESTING
+double distanceTo(const visproc_context& ctx, cv::Size frameSz) {
+	if(ctx.detections.size() == 0) {
+		return -1;
+	}
+	return getDistance(ctx.detections[0].bounds.height, goalSz.height, frameSz.height, fovVert);
+}
+
+/*
+ * --compare-pyramid [scale]: run both the full-resolution and the coarse-to-fine goal
+ * search on every frame, and report the time taken by each and the difference in distance.
+ */
+int comparePyramid(cv::VideoCapture& cap, double scale) {
+	visproc_context fullCtx;
+	visproc_context pyrCtx;
+	pyrCtx.coarseScale = scale;
+
+	double fullTotal = 0;
+	double pyrTotal = 0;
+	double maxDistErr = 0;
+	unsigned int nFrames = 0;
+	unsigned int nMismatch = 0;
+
+	while(true) {
+		cv::Mat src;
+		if( !cap.read(src) ) {
+			std::cerr << "Error reading image from camera";
+			return -1;
+		}
+
+		double t = (double)cv::getTickCount();
+		goal_pipeline(goal_preprocess_pipeline(src, fullCtx, true), fullCtx, true);
+		double fullMs = elapsedMs(t);
+
+		t = (double)cv::getTickCount();
+		goal_pipeline_pyramid(src, pyrCtx, true);
+		double pyrMs = elapsedMs(t);
+
+		double fullDist = distanceTo(fullCtx, src.size());
+		double pyrDist = distanceTo(pyrCtx, src.size());
+
+		nFrames++;
+		fullTotal += fullMs;
+		pyrTotal += pyrMs;
+
+		if((fullDist < 0) != (pyrDist < 0)) {
+			nMismatch++;
+		} else if(fullDist >= 0) {
+			maxDistErr = std::max(maxDistErr, fabs(fullDist - pyrDist));
+		}
+
+		std::cout << "Full: " << fullMs << " ms, " << fullDist << " in. / ";
+		std::cout << "Pyramid: " << pyrMs << " ms, " << pyrDist << " in. / ";
+		std::cout << "Avg speedup: " << (fullTotal / pyrTotal) << "x, ";
+		std::cout << "detection mismatches: " << nMismatch << "/" << nFrames << ", ";
+		std::cout << "max distance error: " << maxDistErr << " in." << std::endl;
+	}
+}
+
+/*
+ * --compare-multi: search every frame for goals and boulders, once with the two pipelines
+ * run separately and once with a multi_target_detector, and report the time taken by each.
+ */
+int compareMulti(cv::VideoCapture& cap) {
+	visproc_context goalCtx;
+	visproc_context boulderCtx;
+	multi_target_detector multi;
+	multi.addTarget(goal_target_class());
+	multi.addTarget(boulder_target_class());
+
+	double separateTotal = 0;
+	double multiTotal = 0;
+
+	while(true) {
+		cv::Mat src;
+		if( !cap.read(src) ) {
+			std::cerr << "Error reading image from camera";
+			return -1;
+		}
+
+		double t = (double)cv::getTickCount();
+		goal_pipeline(goal_preprocess_pipeline(src, goalCtx, true), goalCtx, true);
+		boulder_pipeline(boulder_preprocess_pipeline(src, boulderCtx, true), boulderCtx, true);
+		double separateMs = elapsedMs(t);
+
+		t = (double)cv::getTickCount();
+		const std::vector<target_detection>& found = multi.detect(src, true);
+		double multiMs = elapsedMs(t);
+
+		separateTotal += separateMs;
+		multiTotal += multiMs;
+
+		std::cout << "Separate: " << separateMs << " ms / ";
+		std::cout << "Multi: " << multiMs << " ms, " << found.size() << " detections / ";
+		std::cout << "Avg speedup: " << (separateTotal / multiTotal) << "x" << std::endl;
+	}
+}
+
+/*
+ * --compare-threshold [frames]: preprocess every frame with each fused threshold mode and with
+ * THRES_LEGACY, and report how far apart their masks are: the fraction of pixels that differ straight
+ * out of the color threshold, and after the erosion the pipelines use (the mask contours are found in),
+ * and how far from the legacy mask's edges the differing eroded pixels lie. Prints a summary per mode
+ * after the given number of frames (default 300).
+ */
+struct threshold_mismatch {
+	double rawTotal = 0;	//!< Sum of per-frame mismatch fractions, before erosion.
+	double rawMax = 0;
+	double morphTotal = 0;	//!< Sum of per-frame mismatch fractions, after erosion.
+	double morphMax = 0;
+	double edgeDistMax = 0;	//!< Farthest mismatched eroded pixel from a legacy mask edge, in pixels.
+};
+
+int compareThreshold(cv::VideoCapture& cap, unsigned int nFrames) {
+	const threshold_mode modes[] = { THRES_FUSED, THRES_FUSED_SIMD, THRES_LUT };
+	const char* modeNames[] = { "fused", "fused-simd", "lut" };
+	const int nModes = 3;
+
+	const int savedMode = visproc_thresholdMode;
+	const int savedEngine = visproc_detectEngine;
+	visproc_detectEngine = ENGINE_BLOBS; // preprocessing then stops at the eroded mask
+
+	visproc_context legacyCtx;
+	visproc_context modeCtx[nModes];
+	threshold_mismatch stats[nModes];
+	cv::Mat diff, edges, edgeDist;
+	const cv::Mat edgeKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+
+	for(unsigned int f=0;f<nFrames;f++) {
+		cv::Mat src;
+		if( !cap.read(src) ) {
+			std::cerr << "Error reading image from camera";
+			visproc_thresholdMode = savedMode;
+			visproc_detectEngine = savedEngine;
+			return -1;
+		}
+		const double nPixels = src.total();
+
+		visproc_thresholdMode = THRES_LEGACY;
+		const cv::Mat& legacyMorph = goal_preprocess_pipeline(src, legacyCtx, true);
+
+		/* Distance from every pixel to the nearest edge of the legacy eroded mask */
+		cv::morphologyEx(legacyMorph, edges, cv::MORPH_GRADIENT, edgeKernel);
+		cv::compare(edges, 0, edges, cv::CMP_EQ);
+		cv::distanceTransform(edges, edgeDist, cv::DIST_L2, 3);
+
+		std::cout << "Frame " << f << ":";
+		for(int m=0;m<nModes;m++) {
+			visproc_thresholdMode = modes[m];
+			const cv::Mat& morph = goal_preprocess_pipeline(src, modeCtx[m], true);
+			threshold_mismatch& st = stats[m];
+
+			cv::compare(modeCtx[m].mask, legacyCtx.mask, diff, cv::CMP_NE);
+			const double raw = cv::countNonZero(diff) / nPixels;
+
+			cv::compare(morph, legacyMorph, diff, cv::CMP_NE);
+			const double eroded = cv::countNonZero(diff) / nPixels;
+			double edgeMax = 0;
+			if(eroded > 0) {
+				cv::minMaxLoc(edgeDist, NULL, &edgeMax, NULL, NULL, diff);
+			}
+
+			st.rawTotal += raw;
+			st.rawMax = std::max(st.rawMax, raw);
+			st.morphTotal += eroded;
+			st.morphMax = std::max(st.morphMax, eroded);
+			st.edgeDistMax = std::max(st.edgeDistMax, edgeMax);
+
+			std::cout << " " << modeNames[m] << " " << (100 * raw) << "% / " << (100 * eroded) << "% (" << edgeMax << " px)";
+		}
+		std::cout << std::endl;
+	}
+
+	std::cout << "Mismatch vs. legacy over " << nFrames << " frames (mean / max; threshold, then eroded; farthest from a legacy edge):" << std::endl;
+	for(int m=0;m<nModes;m++) {
+		const threshold_mismatch& st = stats[m];
+		std::cout << modeNames[m] << ": " << (100 * st.rawTotal / nFrames) << "% / " << (100 * st.rawMax) << "%, ";
+		std::cout << (100 * st.morphTotal / nFrames) << "% / " << (100 * st.morphMax) << "%, ";
+		std::cout << st.edgeDistMax << " px" << std::endl;
+	}
+
+	visproc_thresholdMode = savedMode;
+	visproc_detectEngine = savedEngine;
+	return 0;
+}
+
+/*
+ * --compare-contours [frames]: check contour_arena::extract against cv::findContours on the goal pipeline's
+ * edge image and raw threshold mask of every frame, in both list and external modes. The contours must match
+ * exactly: same number, same order, same points.
+ */
+static bool sameContours(const std::vector< std::vector<cv::Point> >& expected, const contour_arena& arena, size_t& firstDiff) {
+	firstDiff = 0;
+	for(;firstDiff < std::min(expected.size(), arena.size());firstDiff++) {
+		const cv::Mat c = arena.contour(firstDiff);
+		const std::vector<cv::Point>& e = expected[firstDiff];
+		if((size_t)c.rows != e.size()) {
+			return false;
+		}
+		for(size_t j=0;j<e.size();j++) {
+			if(c.at<cv::Point>(j) != e[j]) {
+				return false;
+			}
+		}
+	}
+	return expected.size() == arena.size();
+}
+
+int compareContours(cv::VideoCapture& cap, unsigned int nFrames) {
+	const int savedEngine = visproc_detectEngine;
+	visproc_detectEngine = ENGINE_CONTOURS;
+
+	visproc_context ctx;
+	contour_arena arena;
+	std::vector< std::vector<cv::Point> > expected;
+	cv::Mat a, b;
+	unsigned int nContours = 0;
+	unsigned int mismatches = 0;
+
+	for(unsigned int f=0;f<nFrames;f++) {
+		cv::Mat src;
+		if( !cap.read(src) ) {
+			std::cerr << "Error reading image from camera";
+			visproc_detectEngine = savedEngine;
+			return -1;
+		}
+
+		const cv::Mat& edges = goal_preprocess_pipeline(src, ctx, true);
+		const cv::Mat* inputs[] = { &edges, &ctx.mask };
+		const char* inputNames[] = { "edges", "mask" };
+		for(int in=0;in<2;in++) {
+			for(int external=0;external<2;external++) {
+				/* Both trace functions modify their input */
+				inputs[in]->copyTo(a);
+				inputs[in]->copyTo(b);
+				cv::findContours(a, expected, external ? cv::RETR_EXTERNAL : cv::RETR_LIST, cv::CHAIN_APPROX_NONE);
+				arena.clear();
+				arena.extract(b, cv::Point(), 1, external != 0);
+				nContours += expected.size();
+
+				size_t firstDiff;
+				if(!sameContours(expected, arena, firstDiff)) {
+					mismatches++;
+					std::cout << "Frame " << f << ", " << inputNames[in] << (external ? " (external)" : " (list)");
+					std::cout << ": findContours found " << expected.size() << ", arena " << arena.size();
+					std::cout << "; first difference at contour " << firstDiff << std::endl;
+				}
+			}
+		}
+	}
+
+	std::cout << nContours << " contours compared over " << nFrames << " frames, " << mismatches << " mismatched images." << std::endl;
+	visproc_detectEngine = savedEngine;
+	return (mismatches > 0) ? 1 : 0;
+}
+
 int main(int argc, char** argv) {
 	cv::VideoCapture cap(camID); // open cam 1
 	if(!cap.isOpened())  // check if we succeeded
 		return -1;
 
+	if((argc > 1) && (std::string(argv[1]) == "--compare-pyramid")) {
+		return comparePyramid(cap, (argc > 2) ? atof(argv[2]) : 0.25);
+	}
+
+	if((argc > 1) && (std::string(argv[1]) == "--compare-multi")) {
+		return compareMulti(cap);
+	}
+
+	if((argc > 1) && (std::string(argv[1]) == "--compare-threshold")) {
+		return compareThreshold(cap, (argc > 2) ? std::max(1, atoi(argv[2])) : 300);
+	}
+
+	if((argc > 1) && (std::string(argv[1]) == "--compare-contours")) {
+		return compareContours(cap, (argc > 2) ? std::max(1, atoi(argv[2])) : 300);
+	}
+
+	visproc_context ctx;
+	vision_pipeline pipeline;
+
+	/* --pipeline <file>: preprocess with a pipeline description, and report its stage timings */
+	if((argc > 2) && (std::string(argv[1]) == "--pipeline")) {
+		if(!pipeline.load(argv[2])) {
+			return -1;
+		}
+		ctx.preprocess = &pipeline;
+	}
+
+	unsigned int nFrames = 0;
 	while(true) {
 		cv::Mat src;
 		if( !cap.read(src) ) {
@@ -25,10 +319,21 @@ int main(int argc, char** argv) {
 			return -1;
 		}
 
-		scoredContour out = goal_pipeline(goal_preprocess_pipeline(src));
+		goal_pipeline(goal_preprocess_pipeline(src, ctx), ctx);
+
+		nFrames++;
+		if((ctx.preprocess != NULL) && ((nFrames % 30) == 0)) {
+			pipeline.printTimings(std::cout);
+		}
+		if(visproc_profilingEnabled() && ((nFrames % 300) == 0)) {
+			visproc_profileReport(std::cout);
+		}
+		if((nFrames % 300) == 0) {
+			goal_cascade.report(std::cout);
+		}
 
-		if( out.second.size() > 0 ) {
-			cv::Rect bounds = cv::boundingRect(out.second);
+		if( ctx.detections.size() > 0 ) {
+			const cv::Rect& bounds = ctx.detections[0].bounds;
 			double dist = getDistance(bounds.size(), src.size());
 			std::cout << "Distance: " << std::to_string(dist) << " inches" << std::endl;
 		}
@@ -36,6 +341,118 @@ int main(int argc, char** argv) {
 }
 #endif
 
+#ifdef VISPROC_ALLOC_TEST
+/*
+ * allocproc [warmup] [frames]: check that the goal pipelines make no heap allocations once warmed up.
+ *
+ * Every operator new in the process (including the library's) is counted. Each detect engine and threshold
+ * mode is run on a fixed cycle of synthetic frames, through both goal_pipeline and goal_pipeline_pyramid with
+ * every scoring test enabled: warmup frames (default 30) to let the buffers grow, then frames more (default 300)
+ * that must not allocate. Buffers allocated by OpenCV itself (cv::Mat data) go through malloc, and aren't counted.
+ */
+static std::atomic<size_t> allocCount(0);
+
+void* operator new(size_t sz) {
+	allocCount++;
+	void* p = std::malloc((sz > 0) ? sz : 1);
+	if(p == NULL) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t sz) {
+	return operator new(sz);
+}
+
+void* operator new(size_t sz, const std::nothrow_t&) noexcept {
+	allocCount++;
+	return std::malloc((sz > 0) ? sz : 1);
+}
+
+void* operator new[](size_t sz, const std::nothrow_t& nt) noexcept {
+	return operator new(sz, nt);
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+/* A U-shaped goal in the thresholds' hue range on a noisy background, drifting across the frame (and
+ * shrinking) from one frame to the next, so that the ROI and candidate sizes change. */
+static void makeFrames(std::vector<cv::Mat>& frames, int n) {
+	const cv::Scalar tape(200, 255, 0);	// hue 83, full saturation and value
+	for(int i=0;i<n;i++) {
+		cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(40, 40, 40));
+		cv::Mat noise(frame.size(), CV_8UC3);
+		cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(20));
+		cv::add(frame, noise, frame);
+
+		const int w = 160 - (4 * i);
+		const int h = (w * 7) / 10;
+		const int t = w / 8;
+		const cv::Point tl(200 + (12 * i), 150 + (5 * i));
+		cv::rectangle(frame, cv::Rect(tl.x, tl.y, t, h), tape, CV_FILLED);
+		cv::rectangle(frame, cv::Rect(tl.x + w - t, tl.y, t, h), tape, CV_FILLED);
+		cv::rectangle(frame, cv::Rect(tl.x, tl.y + h - t, w, t), tape, CV_FILLED);
+		frames.push_back(frame);
+	}
+}
+
+int main(int argc, char** argv) {
+	const unsigned int nWarmup = (argc > 1) ? std::max(1, atoi(argv[1])) : 30;
+	const unsigned int nFrames = (argc > 2) ? std::max(1, atoi(argv[2])) : 300;
+	const char* engineNames[] = { "contours", "blobs", "rle" };
+	const char* modeNames[] = { "legacy", "fused", "fused-simd", "lut" };
+
+	std::vector<cv::Mat> frames;
+	makeFrames(frames, 8);
+	goal_cascade.setEnabled("profile", true);
+
+	int failures = 0;
+	for(int engine=0;engine<=ENGINE_MAX;engine++) {
+		for(int mode=0;mode<=THRES_MODE_MAX;mode++) {
+			for(int pyramid=0;pyramid<2;pyramid++) {
+				visproc_detectEngine = engine;
+				visproc_thresholdMode = mode;
+				visproc_context ctx;
+				bool found = false;
+
+				size_t allocs = 0;
+				for(unsigned int f=0;f<(nWarmup + nFrames);f++) {
+					if(f == nWarmup) {
+						allocs = allocCount;
+					}
+
+					const cv::Mat& src = frames[f % frames.size()];
+					if(pyramid) {
+						goal_pipeline_pyramid(src, ctx, true);
+					} else {
+						goal_pipeline(goal_preprocess_pipeline(src, ctx, true), ctx, true);
+					}
+					found = found || (ctx.detections.size() > 0);
+				}
+				allocs = allocCount - allocs;
+
+				std::cout << engineNames[engine] << " / " << modeNames[mode] << " / " << (pyramid ? "pyramid" : "full");
+				std::cout << ": " << allocs << " allocations over " << nFrames << " frames";
+				std::cout << (found ? "" : " (goal never found)") << std::endl;
+				if((allocs > 0) || !found) {
+					failures++;
+				}
+			}
+		}
+	}
+
+	std::cout << (failures ? "FAILED" : "passed") << std::endl;
+	return (failures > 0) ? 1 : 0;
+}
+#endif
+
 #ifdef VISPROC_EXTENDED_TESTING
 
 #ifdef VISPROC_BALL_TEST
@@ -63,7 +480,11 @@ int main(int argc, char** argv) {
 		cvCreateTrackbar("Val Min", "input", &(ball_valThres[0]), 255, NULL);
 		cvCreateTrackbar("Val Max", "input", &(ball_valThres[1]), 255, NULL);
 
+		cvCreateTrackbar("Threshold Mode", "input", &visproc_thresholdMode, THRES_MODE_MAX, NULL);
+		cvCreateTrackbar("Detect Engine", "input", &visproc_detectEngine, ENGINE_MAX, NULL);
+
 		std::vector<cv::Point> last_good;
+		visproc_context ctx;
 
 		while(true) {
 			cv::Mat src;
@@ -74,18 +495,18 @@ int main(int argc, char** argv) {
 
 			cv::imshow("input", src);
 
-			std::vector<scoredContour> out = boulder_pipeline(boulder_preprocess_pipeline(src, true, true), true, true);
+			const std::vector<scoredContour>& out = boulder_pipeline(boulder_preprocess_pipeline(src, ctx, true, true), ctx, true, true);
 
 			cv::Mat output = cv::Mat::zeros(src.size(), CV_8UC3);
 
 			std::vector< std::vector<cv::Point> > drawVec;
 
-			for(std::vector<scoredContour>::iterator it = out.begin();it != out.end();++it) {
-				if(it->first < 85.0)
+			for(size_t i=0;i<out.size();i++) {
+				if(out[i].first < 85.0)
 					continue;
 
-				drawVec.push_back(it->second);
-				cv::Rect bounds = cv::boundingRect(it->second);
+				drawVec.push_back(out[i].second);
+				const cv::Rect& bounds = ctx.detections[i].bounds;
 
 				cv::Point center(bounds.tl().x+(bounds.width / 2), bounds.tl().y+(bounds.height/2));
 
@@ -127,7 +548,11 @@ int main(int argc, char** argv) {
 		cvCreateTrackbar("Val Min", "input", &(goal_valThres[0]), 255, NULL);
 		cvCreateTrackbar("Val Max", "input", &(goal_valThres[1]), 255, NULL);
 
+		cvCreateTrackbar("Threshold Mode", "input", &visproc_thresholdMode, THRES_MODE_MAX, NULL);
+		cvCreateTrackbar("Detect Engine", "input", &visproc_detectEngine, ENGINE_MAX, NULL);
+
 		std::vector<cv::Point> last_good;
+		visproc_context ctx;
 
 		while(true) {
 			cv::Mat src;
@@ -140,7 +565,7 @@ int main(int argc, char** argv) {
 
 			double t = (double)cv::getTickCount();
 
-			scoredContour out = goal_pipeline(goal_preprocess_pipeline(src, true, true), true);
+			const scoredContour& out = goal_pipeline(goal_preprocess_pipeline(src, ctx, true, true), ctx, true);
 
 			double fps = 1 / (((double)cv::getTickCount() - t) / cv::getTickFrequency());
 
@@ -151,11 +576,12 @@ int main(int argc, char** argv) {
 				std::vector< std::vector<cv::Point> > drawVec;
 				drawVec.push_back(out.second);
 
-				cv::Rect bounds = cv::boundingRect(out.second);
+				const contour_record& best = ctx.detections[0];
+				const cv::Rect& bounds = best.bounds;
 				last_good = out.second;
 
 				double distance = getDistance(bounds.size(), src.size());
-				std::pair<double, double> angles = getRelativeAngleOffCenter(out, bounds.size(), distance);
+				std::pair<double, double> angles = getRelativeAngleOffCenter(best, bounds.size(), distance);
 				double angleToTarget = getAngleOffCenterline(bounds.size());
 
 				cv::Scalar col(255,255,255);
@@ -181,4 +607,137 @@ int main(int argc, char** argv) {
 }
 #endif
 
+#ifdef VISPROC_OBSTACLE_TEST
+/* The per-pixel classification obs_classify replaced, for checking its output in --bench. */
+static void obstacleMaskReference(const cv::Mat& hsv, const obstacle_model& hist, cv::Mat& out) {
+	out = cv::Mat::zeros(hsv.size(), CV_8U);
+	for(int y=0;y<hsv.rows;y++) {
+		for(int x=0;x<hsv.cols;x++) {
+			const cv::Vec3b& p = hsv.at<cv::Vec3b>(y, x);
+			unsigned char& o = out.at<unsigned char>(y, x);
+
+			if(hist.val[p[2]] < obs_valHistBinThres) {
+				o = 255;
+				continue;
+			}
+
+			if(p[2] >= obs_valThres) {
+				if(hist.sat[p[1]] < obs_satHistBinThres) {
+					o = 255;
+					continue;
+				}
+				if((p[1] >= obs_satThres) && (hist.hue[p[0]] < obs_hueHistBinThres)) {
+					o = 255;
+				}
+			}
+		}
+	}
+}
+
+/*
+ * --bench [frames]: time obstacle detection on camera frames without any windows, and check
+ * the table-driven classification against the per-pixel reference.
+ */
+int obstacleBench(cv::VideoCapture& cap, obstacle_context& ctx, unsigned int nFrames) {
+	cv::Mat ref;
+	double fullTotal = 0;
+	double classifyTotal = 0;
+	double refTotal = 0;
+	unsigned int nMismatch = 0;
+
+	for(unsigned int i=0;i<nFrames;i++) {
+		cv::Mat src;
+		if( !cap.read(src) ) {
+			std::cerr << "Error reading image from camera";
+			return -1;
+		}
+
+		double t = (double)cv::getTickCount();
+		obs_getObsMask(src, ctx);
+		fullTotal += elapsedMs(t);
+
+		t = (double)cv::getTickCount();
+		obs_buildLUTs(ctx);
+		obs_classify(ctx.hsv, ctx);
+		classifyTotal += elapsedMs(t);
+
+		t = (double)cv::getTickCount();
+		obstacleMaskReference(ctx.hsv, ctx.model, ref);
+		refTotal += elapsedMs(t);
+
+		if(cv::countNonZero(ref != ctx.mask) > 0) {
+			nMismatch++;
+		}
+	}
+
+	if(nFrames > 0) {
+		std::cout << nFrames << " frames: " << (fullTotal / nFrames) << " ms/frame total, ";
+		std::cout << (classifyTotal / nFrames) << " ms/frame classifying (reference: " << (refTotal / nFrames) << " ms/frame), ";
+		std::cout << nMismatch << " frames differing from the reference" << std::endl;
+	}
+	return (nMismatch > 0) ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+	cv::VideoCapture cap(1); // open cam 1
+	if(!cap.isOpened())  // check if we succeeded
+		return -1;
+
+	/* --decay <x>: floor model decay; --refresh-every <n>: rescan the floor patch every n frames */
+	obstacle_context ctx;
+	for(int i=1;i<argc;i++) {
+		if((std::string(argv[i]) == "--decay") && (i+1 < argc)) {
+			ctx.decay = std::min(1.0, std::max(0.0, atof(argv[++i])));
+		} else if((std::string(argv[i]) == "--refresh-every") && (i+1 < argc)) {
+			ctx.refreshEvery = std::max(1, atoi(argv[++i]));
+		} else if(std::string(argv[i]) == "--bench") {
+			unsigned int nFrames = ((i+1 < argc) && (argv[i+1][0] != '-')) ? atoi(argv[i+1]) : 300;
+			return obstacleBench(cap, ctx, nFrames);
+		}
+	}
+
+	cv::namedWindow("input");
+	cv::namedWindow("mask");
+	cv::namedWindow("output");
+
+	std::cout << "Width: " << cap.get(CV_CAP_PROP_FRAME_WIDTH) << std::endl;
+	std::cout << "Height: " << cap.get(CV_CAP_PROP_FRAME_HEIGHT) << std::endl;
+
+	cvCreateTrackbar("Val Thres", "input", &obs_valHistBinThres, 500, NULL);
+	cvCreateTrackbar("Sat Thres", "input", &obs_satHistBinThres, 500, NULL);
+	cvCreateTrackbar("Hue Thres", "input", &obs_hueHistBinThres, 500, NULL);
+
+	std::vector< std::vector<cv::Point> > drawVec;
+	drawVec.push_back(obs_refTrapezoid);
+
+	while(true) {
+		cv::Mat src;
+		cap >> src;
+
+		cv::Mat tmp;
+		src.copyTo(tmp);
+		cv::drawContours(tmp, drawVec, -1, cv::Scalar(255,255,255));
+
+		cv::imshow("input", tmp);
+
+		const cv::Mat& obsMask = obs_getObsMask(src, ctx);
+
+		cv::imshow("mask", obsMask);
+
+		cv::Mat edgedet;
+
+		cv::blur(obsMask, edgedet, cv::Size(3,3));
+
+		cv::Mat detOut;
+		cv::Canny(edgedet, detOut, 10, 20);
+
+		cv::imshow("output", detOut);
+
+		if(cv::waitKey(30) > 0) break;
+	}
+
+	return 0;
+}
+#endif
+
 #endif
@@ -0,0 +1,333 @@
+#include "vision_pipeline.h"
+#include "visproc_common.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+/*! \file vision_pipeline.cpp
+ *  \brief Loading, buffer assignment and execution for vision_pipeline.
+ */
+
+static const char* stageNames[] = { "hsv", "gaussian", "threshold", "erode", "dilate", "blur", "canny" };
+static const int nStageNames = sizeof(stageNames) / sizeof(stageNames[0]);
+
+const char* pipelineStageName(pipeline_stage_type type) {
+	return stageNames[type];
+}
+
+pipeline_stage::pipeline_stage(pipeline_stage_type t) : type(t), name(pipelineStageName(t)), ksize(3, 3), border(cv::BORDER_DEFAULT), inputFormat(FORMAT_BGR) {}
+
+/* Read a [w, h] pair (or a single number, for a square kernel). */
+static cv::Size readSize(const cv::FileNode& node, cv::Size def) {
+	if(node.empty()) {
+		return def;
+	}
+	if(node.isSeq() && (node.size() == 2)) {
+		return cv::Size((int)node[0], (int)node[1]);
+	}
+	int n = (int)node;
+	return cv::Size(n, n);
+}
+
+static bool readHSV(const cv::FileNode& node, int* hsv) {
+	if(!node.isSeq() || (node.size() != 3)) {
+		return false;
+	}
+	for(int i=0;i<3;i++) {
+		hsv[i] = (int)node[i];
+	}
+	return true;
+}
+
+/*!	\fn vision_pipeline::load(const std::string& path)
+ *	\brief Replace this pipeline's stages with those described in a FileStorage (YAML / XML) file.
+ *
+ *	See vision_pipeline.h for the file format. Errors are reported on stderr.
+ *	\return true if the file was read and every stage was valid; on failure the pipeline is left empty.
+ */
+bool vision_pipeline::load(const std::string& path) {
+	clear();
+
+	cv::FileStorage fs(path, cv::FileStorage::READ);
+	if(!fs.isOpened()) {
+		std::cerr << "Could not open pipeline file " << path << std::endl;
+		return false;
+	}
+
+	cv::FileNode nameNode = fs["name"];
+	name = nameNode.empty() ? path : (std::string)nameNode;
+
+	cv::FileNode list = fs["stages"];
+	if(!list.isSeq()) {
+		std::cerr << path << ": expected a sequence of stages" << std::endl;
+		return false;
+	}
+
+	for(cv::FileNodeIterator it = list.begin();it != list.end();++it) {
+		cv::FileNode n = *it;
+		std::string type = (std::string)n["type"];
+
+		int t = 0;
+		while((t < nStageNames) && (type != stageNames[t])) {
+			t++;
+		}
+		if(t == nStageNames) {
+			std::cerr << path << ": unknown stage type '" << type << "'" << std::endl;
+			clear();
+			return false;
+		}
+
+		pipeline_stage stage((pipeline_stage_type)t);
+		if(!n["name"].empty()) {
+			stage.name = (std::string)n["name"];
+		}
+
+		switch(stage.type) {
+		case STAGE_GAUSSIAN:
+		{
+			stage.ksize = readSize(n["ksize"], cv::Size(5, 5));
+			if(!n["sigma"].empty()) {
+				stage.sigma = (double)n["sigma"];
+			}
+
+			std::string border = n["border"].empty() ? std::string("default") : (std::string)n["border"];
+			if(border == "replicate") {
+				stage.border = cv::BORDER_REPLICATE;
+			} else if(border == "reflect") {
+				stage.border = cv::BORDER_REFLECT;
+			} else if(border != "default") {
+				std::cerr << path << ": unknown border mode '" << border << "'" << std::endl;
+				clear();
+				return false;
+			}
+			break;
+		}
+		case STAGE_THRESHOLD:
+		{
+			std::string target = n["target"].empty() ? std::string("custom") : (std::string)n["target"];
+			int lo[3], hi[3];
+
+			if(target == "goal") {
+				stage.target = TARGET_GOAL;
+			} else if(target == "ball") {
+				stage.target = TARGET_BALL;
+			} else if((target == "custom") && readHSV(n["min"], lo) && readHSV(n["max"], hi)) {
+				stage.target = TARGET_CUSTOM;
+				stage.range = hsv_range(lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+			} else {
+				std::cerr << path << ": threshold stages need a target (goal / ball) or min and max as [h, s, v]" << std::endl;
+				clear();
+				return false;
+			}
+			break;
+		}
+		case STAGE_ERODE:
+		case STAGE_DILATE:
+		case STAGE_BLUR:
+			stage.ksize = readSize(n["ksize"], cv::Size(3, 3));
+			break;
+		case STAGE_CANNY:
+			if(!n["low"].empty()) {
+				stage.cannyLow = (double)n["low"];
+			}
+			if(!n["high"].empty()) {
+				stage.cannyHigh = (double)n["high"];
+			}
+			break;
+		default:
+			break;
+		}
+
+		if(!addStage(stage)) {
+			std::cerr << path << ": in stage " << stages.size() << " (" << stage.name << ")" << std::endl;
+			clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Find a buffer of the given OpenCV type that isn't the one being read, adding one if needed. */
+int vision_pipeline::getBuffer(int type, int notThis) {
+	for(size_t i=0;i<bufferTypes.size();i++) {
+		if((bufferTypes[i] == type) && ((int)i != notThis)) {
+			return i;
+		}
+	}
+
+	buffers.push_back(cv::Mat());
+	bufferTypes.push_back(type);
+	return buffers.size() - 1;
+}
+
+/*!	\fn vision_pipeline::addStage(const pipeline_stage& stage)
+ *	\brief Append a stage, checking that it accepts the previous stage's output and assigning its buffers.
+ *	\return false (with a message on stderr) if the stage can't follow the current last stage.
+ */
+bool vision_pipeline::addStage(const pipeline_stage& stage) {
+	pipeline_stage s = stage;
+	pipeline_format out = format;
+
+	switch(s.type) {
+	case STAGE_HSV:
+		if(format != FORMAT_BGR) {
+			std::cerr << "hsv stage needs a BGR input" << std::endl;
+			return false;
+		}
+		out = FORMAT_HSV;
+		break;
+	case STAGE_THRESHOLD:
+		if(format == FORMAT_MASK) {
+			std::cerr << "threshold stage needs a BGR or HSV input" << std::endl;
+			return false;
+		}
+		out = FORMAT_MASK;
+		break;
+	case STAGE_ERODE:
+	case STAGE_DILATE:
+		s.kernel = cv::getStructuringElement(cv::MORPH_RECT, s.ksize);
+		break;
+	case STAGE_CANNY:
+		if(format != FORMAT_MASK) {
+			std::cerr << "canny stage needs a 1-channel input" << std::endl;
+			return false;
+		}
+		break;
+	default:
+		break;
+	}
+
+	s.inputFormat = format;
+	s.input = stages.empty() ? -1 : stages.back().output;
+	s.output = getBuffer((out == FORMAT_MASK) ? CV_8U : CV_8UC3, s.input);
+
+	stages.push_back(s);
+	format = out;
+	return true;
+}
+
+void vision_pipeline::clear() {
+	stages.clear();
+	buffers.clear();
+	bufferTypes.clear();
+	format = FORMAT_BGR;
+}
+
+/* Bounds for a threshold stage, read from the live globals for the built-in targets. */
+static hsv_range stageRange(const pipeline_stage& s) {
+	if(s.target == TARGET_GOAL) {
+		return hsv_range(goal_hueThres[0], goal_hueThres[1], 0, 255, goal_valThres[0], goal_valThres[1]);
+	} else if(s.target == TARGET_BALL) {
+		return hsv_range(ball_hueThres[0], ball_hueThres[1], ball_satThres[0], ball_satThres[1], ball_valThres[0], ball_valThres[1]);
+	}
+	return s.range;
+}
+
+static void runThreshold(const pipeline_stage& s, const cv::Mat& in, cv::Mat& out) {
+	hsv_range range = stageRange(s);
+
+	if(s.inputFormat == FORMAT_HSV) {
+		cv::inRange(in, cv::Scalar(range.min[0], range.min[1], range.min[2]), cv::Scalar(range.max[0], range.max[1], range.max[2]), out);
+		return;
+	}
+
+	if((visproc_thresholdMode == THRES_LUT) && (s.target != TARGET_CUSTOM)) {
+		hsv_color_lut& lut = (s.target == TARGET_GOAL) ? goal_colorLUT : ball_colorLUT;
+		lut.update(range);
+		lut.apply(in, out);
+	} else {
+		fusedHSVThreshold(in, out, range, (visproc_thresholdMode == THRES_FUSED_SIMD) ? THRES_FUSED_SIMD : THRES_FUSED);
+	}
+}
+
+/*!	\fn vision_pipeline::run(cv::Mat input, bool live_output)
+ *	\brief Run every stage on a frame, timing each one.
+ *
+ *	\param input Input frame (BGR). May be a submatrix.
+ *	\param live_output If true, each stage's output is shown in a GUI window named after the stage.
+ *	\return The last stage's output buffer, valid until the next run() (or the input, if there are no stages).
+ */
+cv::Mat& vision_pipeline::run(cv::Mat input, bool live_output) {
+	if(stages.empty()) {
+		passthrough = input;
+		return passthrough;
+	}
+
+	for(size_t i=0;i<stages.size();i++) {
+		pipeline_stage& s = stages[i];
+		const cv::Mat& in = (s.input < 0) ? input : buffers[s.input];
+		cv::Mat& out = buffers[s.output];
+
+		double t = (double)cv::getTickCount();
+
+		switch(s.type) {
+		case STAGE_HSV:
+			cv::cvtColor(in, out, CV_BGR2HSV);
+			break;
+		case STAGE_GAUSSIAN:
+			cv::GaussianBlur(in, out, s.ksize, s.sigma, s.sigma, s.border);
+			break;
+		case STAGE_THRESHOLD:
+			runThreshold(s, in, out);
+			break;
+		case STAGE_ERODE:
+			cv::erode(in, out, s.kernel);
+			break;
+		case STAGE_DILATE:
+			cv::dilate(in, out, s.kernel);
+			break;
+		case STAGE_BLUR:
+			cv::blur(in, out, s.ksize);
+			break;
+		case STAGE_CANNY:
+			cv::Canny(in, out, s.cannyLow, s.cannyHigh);
+			break;
+		}
+
+		s.lastMs = (((double)cv::getTickCount() - t) * 1000.0) / cv::getTickFrequency();
+		s.totalMs += s.lastMs;
+		s.runs++;
+
+		drawOut(s.name.c_str(), out, live_output);
+	}
+
+	return buffers[stages.back().output];
+}
+
+/*!	\fn vision_pipeline::printTimings(std::ostream& out)
+ *	\brief Write the last and mean wall time of each stage, and of the whole chain.
+ */
+void vision_pipeline::printTimings(std::ostream& out) const {
+	double lastTotal = 0;
+	double meanTotal = 0;
+	std::ios_base::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << "Pipeline " << name << ":" << std::endl;
+	for(size_t i=0;i<stages.size();i++) {
+		const pipeline_stage& s = stages[i];
+		double mean = (s.runs > 0) ? (s.totalMs / s.runs) : 0;
+
+		out << "  " << std::left << std::setw(16) << s.name << std::right << std::fixed << std::setprecision(3);
+		out << std::setw(9) << s.lastMs << " ms (mean " << std::setw(9) << mean << " ms)" << std::endl;
+
+		lastTotal += s.lastMs;
+		meanTotal += mean;
+	}
+	out << "  " << std::left << std::setw(16) << "total" << std::right;
+	out << std::setw(9) << lastTotal << " ms (mean " << std::setw(9) << meanTotal << " ms)" << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void vision_pipeline::resetTimings() {
+	for(size_t i=0;i<stages.size();i++) {
+		stages[i].lastMs = 0;
+		stages[i].totalMs = 0;
+		stages[i].runs = 0;
+	}
+}
@@ -0,0 +1,85 @@
+#include "visproc_context.h"
+#include "visproc_common.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include <algorithm>
+
+/*! \file visproc_context.cpp
+ *  \brief Buffer management and frame-to-frame tracking state for visproc_context.
+ */
+
+const cv::Mat& visproc_context::getMorphKernel(cv::Size sz) {
+	if(morphKernel.empty() || (morphKernelSize != sz)) {
+		morphKernel = cv::getStructuringElement(cv::MORPH_RECT, sz);
+		morphKernelSize = sz;
+	}
+	return morphKernel;
+}
+
+/*!	\fn visproc_context::beginFrame(cv::Size frameSz)
+ *	\brief Pick the region of the next frame to process.
+ *
+ *	Returns the full frame unless ROI tracking is enabled and a target was found within the
+ *	last roiMaxMisses frames, in which case the last detection's bounding box is expanded by
+ *	roiExpand times its size (and at least roiMinMargin pixels) on each side.
+ *	If tracker is set, its best track's bounding box, predicted to the current time, is used instead
+ *	of the last detection (so the window leads a moving target rather than trailing it).
+ *	The result is also stored in roi.
+ */
+cv::Rect visproc_context::beginFrame(cv::Size frameSz) {
+	cv::Rect frame(0, 0, frameSz.width, frameSz.height);
+
+	if(frameSz != frameSize) { // new stream or resolution change: forget anything we were tracking
+		frameSize = frameSz;
+		lastBounds = cv::Rect();
+		missCount = 0;
+	}
+
+	cv::Rect last = lastBounds;
+	unsigned int misses = missCount;
+	if(tracker != NULL) {
+		const target_track* t = tracker->best();
+		if(t != NULL) {
+			last = t->bounds(tracker->secondsSince(*t, cv::getTickCount()));
+			misses = t->misses;
+		} else {
+			last = cv::Rect();
+		}
+	}
+
+	if(!roiTracking || (last.area() == 0) || (misses >= roiMaxMisses)) {
+		roi = frame;
+		return roi;
+	}
+
+	int dx = std::max((int)(last.width * roiExpand), roiMinMargin);
+	int dy = std::max((int)(last.height * roiExpand), roiMinMargin);
+
+	roi = cv::Rect(last.x - dx, last.y - dy, last.width + (2*dx), last.height + (2*dy)) & frame;
+	if(roi.area() == 0) { // predicted off-frame
+		roi = frame;
+	}
+	return roi;
+}
+
+/*!	\fn visproc_context::clearCandidates()
+ *	\brief Forget the last frame's contours and its frameDegraded flag; call once per frame before scoring.
+ */
+void visproc_context::clearCandidates() {
+	arena.clear();
+	frameDegraded = false;
+}
+
+/*!	\fn visproc_context::endFrame(const std::vector<contour_record>& detections)
+ *	\brief Record the outcome of a frame for ROI tracking.
+ *
+ *	\param detections Detections found this frame (in full-frame coordinates), best first; empty if nothing was found.
+ */
+void visproc_context::endFrame(const std::vector<contour_record>& detections) {
+	if(detections.size() > 0) {
+		lastBounds = detections[0].bounds;
+		missCount = 0;
+	} else {
+		missCount++;
+	}
+}
@@ -0,0 +1,160 @@
+#include "visproc_profiler.h"
+#include "opencv2/core.hpp"
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+/*! \file visproc_profiler.cpp
+ *  \brief Latency histograms and reporting for the VISPROC_PROFILE() timers.
+ */
+
+static const char* profileStageNames[PROF_STAGE_COUNT] = {
+	"preprocess", "stage1 (hsv)", "stage2 (threshold)", "stage3 (morph)",
+	"stage4 (blur)", "stage5 (canny)", "contours", "scoring", "scoring (parallel)"
+};
+
+static latency_histogram profileHistograms[PROF_STAGE_COUNT];
+
+const char* profileStageName(profile_stage stage) {
+	return profileStageNames[stage];
+}
+
+/* Values below 8 us get a bucket each; above that, each power of two is split into four buckets. */
+int latency_histogram::bucketIndex(uint32_t us) {
+	if(us < 8) {
+		return us;
+	}
+	int octave = 31 - __builtin_clz(us);
+	int sub = (us >> (octave - 2)) & 3;
+	return (4 * (octave - 1)) + sub;
+}
+
+uint32_t latency_histogram::bucketUpperBound(int idx) {
+	if(idx < 8) {
+		return idx;
+	}
+	int octave = (idx / 4) + 1;
+	int sub = idx % 4;
+	uint64_t lower = (uint64_t)(4 + sub) << (octave - 2);
+	uint64_t upper = lower + ((uint64_t)1 << (octave - 2)) - 1;
+	return (upper > UINT32_MAX) ? UINT32_MAX : (uint32_t)upper;
+}
+
+void latency_histogram::record(uint32_t us) {
+	buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+	n.fetch_add(1, std::memory_order_relaxed);
+	totalUs.fetch_add(us, std::memory_order_relaxed);
+
+	uint32_t prev = maxUs.load(std::memory_order_relaxed);
+	while((us > prev) && !maxUs.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+}
+
+void latency_histogram::reset() {
+	for(int i=0;i<nBuckets;i++) {
+		buckets[i].store(0, std::memory_order_relaxed);
+	}
+	n.store(0, std::memory_order_relaxed);
+	maxUs.store(0, std::memory_order_relaxed);
+	totalUs.store(0, std::memory_order_relaxed);
+}
+
+double latency_histogram::mean() const {
+	uint32_t count = n.load(std::memory_order_relaxed);
+	return (count > 0) ? ((double)totalUs.load(std::memory_order_relaxed) / count) : 0;
+}
+
+/*!	\fn latency_histogram::percentile(double p)
+ *	\brief Upper bound on the p-th percentile (0 < p <= 100), in microseconds; 0 if nothing has been recorded.
+ *
+ *	Uses the nearest-rank definition: the smallest sample with at least p% of all samples at or below it,
+ *	i.e. sample ceil(p/100 * count) in sorted order. Samples recorded while this runs may or may not be counted.
+ */
+uint32_t latency_histogram::percentile(double p) const {
+	uint64_t counts[nBuckets];
+	uint64_t total = 0;
+	for(int i=0;i<nBuckets;i++) {
+		counts[i] = buckets[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+
+	if(total == 0) {
+		return 0;
+	}
+
+	/* p * total is exact for whole percentages, so a whole rank isn't pushed up by rounding */
+	uint64_t rank = (uint64_t)std::ceil((p * total) / 100.0);
+	rank = std::max<uint64_t>(1, std::min(rank, total));
+
+	uint64_t seen = 0;
+	for(int i=0;i<nBuckets;i++) {
+		seen += counts[i];
+		if(seen >= rank) {
+			return std::min(bucketUpperBound(i), max());
+		}
+	}
+	return max();
+}
+
+/*!	\fn visproc_profileRecord(profile_stage stage, int64_t ticks)
+ *	\brief Add a sample (in cv::getTickCount() ticks) to a stage's histogram. Called by scoped_stage_timer.
+ */
+void visproc_profileRecord(profile_stage stage, int64_t ticks) {
+	static const double usPerTick = 1000000.0 / cv::getTickFrequency();
+
+	double us = ticks * usPerTick;
+	profileHistograms[stage].record((us >= UINT32_MAX) ? UINT32_MAX : (uint32_t)us);
+}
+
+/*!	\fn visproc_profileReport(std::ostream& out)
+ *	\brief Write sample count, mean, p50 / p95 / p99 and max latency (in microseconds) for every stage with samples.
+ *
+ *	Safe to call from any thread while the pipelines are running.
+ */
+void visproc_profileReport(std::ostream& out) {
+	if(!visproc_profilingEnabled()) {
+		out << "Profiling is disabled (rebuild lib5002-vis.so with PROFILING=1)." << std::endl;
+		return;
+	}
+
+	std::ios_base::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << std::left << std::setw(20) << "stage" << std::right;
+	out << std::setw(10) << "count" << std::setw(10) << "mean" << std::setw(10) << "p50";
+	out << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max" << "  (us)" << std::endl;
+
+	for(int i=0;i<PROF_STAGE_COUNT;i++) {
+		const latency_histogram& h = profileHistograms[i];
+		if(h.count() == 0) {
+			continue;
+		}
+
+		out << std::left << std::setw(20) << profileStageNames[i] << std::right;
+		out << std::setw(10) << h.count() << std::setw(10) << std::fixed << std::setprecision(0) << h.mean();
+		out << std::setw(10) << h.percentile(50) << std::setw(10) << h.percentile(95);
+		out << std::setw(10) << h.percentile(99) << std::setw(10) << h.max() << std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void visproc_profileReset() {
+	for(int i=0;i<PROF_STAGE_COUNT;i++) {
+		profileHistograms[i].reset();
+	}
+}
+
+/*!	\fn visproc_profilingEnabled()
+ *	\brief Whether the library was built with VISPROC_PROFILING, i.e. whether any samples will be recorded.
+ */
+bool visproc_profilingEnabled() {
+#ifdef VISPROC_PROFILING
+	return true;
+#else
+	return false;
+#endif
+}
@@ -39,6 +39,10 @@ const unsigned int	vectorDrawSz = 5;
 const unsigned int	colorIncrement = 255 / nFramesBetweenCycles;
 
 std::pair<double, double> projectToGroundPlane(cv::Point2f imgPoint) {
+	if(visproc_camera.calibrated()) {
+		return visproc_camera.projectToGroundPlane(imgPoint, cameraHeight, cameraTiltAngle);
+	}
+
 	double angleToGround = atan((2*double(imgPoint.y) - double(cameraSize.height)) * tan(cameraVFOV/2));
 	//double angleX = atan((2*imgPoint.x - cameraSize.width) * tan(cameraHFOV/2));
 	
@@ -637,7 +641,12 @@ void onTrackbarUpdate(int pos, void* ptr) {
 }
 
 
-int main() {
+int main(int argc, char** argv) {
+	// optional argument: camera calibration file, for lens-corrected ground plane projection
+	if((argc > 1) && !visproc_camera.load(argv[1])) {
+		return -1;
+	}
+
 	cv::namedWindow(processWindowName);
 	cv::namedWindow(posWindowName);
 
@@ -651,6 +660,7 @@ int main() {
 		return -1;
 
 	cameraSize = cv::Size(cam.get(CV_CAP_PROP_FRAME_WIDTH), cam.get(CV_CAP_PROP_FRAME_HEIGHT));
+	visproc_camera.setResolution(cameraSize);
 
 	cv::Mat currentVectorPos(cameraSize, CV_8UC3);
 